@@ -20,10 +20,233 @@
 #include <type_traits>
 #include <random>
 #include <array>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <cstddef>
+#include <cstring>
+#if __cplusplus >= 201703L
+#include <memory_resource>
+#endif
 
 namespace utils
 {
 
+template<class Engine> class checkpoint_index;
+
+template<class Engine, std::size_t Steps> class isaac_incremental;
+
+/************************************************************
+Storage policies for the result_ and memory_ arrays of an
+engine, selected with the Storage parameter of isaac and
+isaac64. A policy's state template provides the two arrays,
+of N words each, as members named result_ and memory_.
+*************************************************************/
+
+/*
+	The arrays are stored inside the engine. This is the default;
+	engines are trivially copyable, but moving one copies its state.
+*/
+struct isaac_inline_storage
+{
+	template<class T, std::size_t N>
+	struct state
+	{
+		T result_[N];
+		T memory_[N];
+	};
+};
+
+/*
+	Like isaac_inline_storage, but each array starts on an Align-byte boundary,
+	and the engine is padded to a multiple of Align bytes. With the default of
+	64, the cache line size of current x86 and most ARM cores, a block's
+	results and memory occupy the fewest possible lines, and engines stored in
+	an array never share a line, so engines used by different threads don't
+	falsely share. Engines stay trivially copyable. Memory for an array of
+	engines must honour the alignment: before C++17, operator new doesn't,
+	so e.g. a std::vector needs an allocator that does, such as
+	isaac_page_allocator (see isaac_page_allocator.h). For the same reason,
+	lazy_isaac, forkable_isaac, isaac_pool and isaac_percpu, which allocate
+	their engines with new, and isaac_async, which can't be moved and so is
+	usually allocated with new, refuse these engines before C++17.
+*/
+template<std::size_t Align = 64>
+struct isaac_aligned_storage
+{
+	template<class T, std::size_t N>
+	struct state
+	{
+		alignas(Align) T result_[N];
+		alignas(Align) T memory_[N];
+	};
+};
+
+/*
+	True if new T is suitably aligned: always with C++17, and before that
+	only up to the alignment of std::max_align_t.
+*/
+template<class T>
+struct _isaac_new_aligns : std::integral_constant<bool, (__cplusplus >= 201703L || alignof(T) <= alignof(std::max_align_t))>
+{};
+
+/*
+	The arrays share one block obtained from an allocator, owned through a
+	pointer, so engines move and swap in constant time. Alloc is rebound to
+	the word type. As with the standard containers, the allocator is copied
+	with select_on_container_copy_construction(), and replaced on assignment
+	only if it propagates; between unequal allocators that don't, a move
+	copies the state. A moved-from engine may only be assigned to or destroyed.
+*/
+template<class Alloc>
+struct isaac_allocator_storage
+{
+	template<class T, std::size_t N>
+	class state
+	{
+		using alloc_traits = typename std::allocator_traits<Alloc>::template rebind_traits<T>;
+
+	public:
+		using allocator_type = typename alloc_traits::allocator_type;
+
+		static_assert(std::is_same<typename alloc_traits::pointer, T*>::value, "allocators with fancy pointers aren't supported");
+
+		state()
+		:
+		state(allocator_type())
+		{}
+
+		explicit state(const allocator_type& alloc)
+		:
+		alloc_(alloc),
+		result_(alloc_traits::allocate(alloc_, 2 * N)),
+		memory_(result_ + N)
+		{}
+
+		state(const state& rhs)
+		:
+		state(alloc_traits::select_on_container_copy_construction(rhs.alloc_))
+		{
+			std::copy(rhs.result_, rhs.result_ + 2 * N, result_);
+		}
+
+		state(state&& rhs) noexcept
+		:
+		alloc_(std::move(rhs.alloc_)),
+		result_(rhs.result_),
+		memory_(rhs.memory_)
+		{
+			rhs.result_ = nullptr;
+			rhs.memory_ = nullptr;
+		}
+
+		state&
+		operator=(const state& rhs)
+		{
+			if (this != &rhs)
+			{
+				copy_allocator(rhs.alloc_, typename alloc_traits::propagate_on_container_copy_assignment());
+				copy_values(rhs);
+			}
+			return *this;
+		}
+
+		state&
+		operator=(state&& rhs) noexcept(alloc_traits::propagate_on_container_move_assignment::value)
+		{
+			if (this != &rhs)
+			{
+				move_assign(rhs, typename alloc_traits::propagate_on_container_move_assignment());
+			}
+			return *this;
+		}
+
+		~state()
+		{
+			deallocate();
+		}
+
+		allocator_type
+		get_allocator() const
+		{
+			return alloc_;
+		}
+
+	private:
+		void
+		deallocate()
+		{
+			if (result_ != nullptr)
+			{
+				alloc_traits::deallocate(alloc_, result_, 2 * N);
+				result_ = nullptr;
+				memory_ = nullptr;
+			}
+		}
+
+		void
+		copy_values(const state& rhs)
+		{
+			if (result_ == nullptr)
+			{
+				result_ = alloc_traits::allocate(alloc_, 2 * N);
+				memory_ = result_ + N;
+			}
+			std::copy(rhs.result_, rhs.result_ + 2 * N, result_);
+		}
+
+		void
+		copy_allocator(const allocator_type& alloc, std::true_type)
+		{
+			if (alloc_ != alloc)
+			{
+				deallocate();
+				alloc_ = alloc;
+			}
+		}
+
+		void
+		copy_allocator(const allocator_type&, std::false_type)
+		{}
+
+		void
+		move_assign(state& rhs, std::true_type)
+		{
+			deallocate();
+			alloc_ = std::move(rhs.alloc_);
+			std::swap(result_, rhs.result_);
+			std::swap(memory_, rhs.memory_);
+		}
+
+		void
+		move_assign(state& rhs, std::false_type)
+		{
+			if (alloc_ == rhs.alloc_)
+			{
+				std::swap(result_, rhs.result_);
+				std::swap(memory_, rhs.memory_);
+			}
+			else
+			{
+				copy_values(rhs);
+			}
+		}
+
+		allocator_type alloc_;
+
+	public:
+		T* result_;
+		T* memory_;
+	};
+};
+
+/*
+	The arrays are allocated with new.
+*/
+struct isaac_heap_storage : isaac_allocator_storage<std::allocator<unsigned char>>
+{};
+
 /************************************************************
 _isaac contains code common to isaac and isaac64.
 It uses CRTP (a.k.a. 'static polymorphism') to invoke
@@ -34,15 +257,21 @@ Applications should not specialize or instantiate this
 template directly.
 *************************************************************/
 
-template<class Derived, std::size_t Alpha, class T>
-class _isaac
+template<class Derived, std::size_t Alpha, class T, class Storage>
+class _isaac : protected Storage::template state<T, std::size_t(1) << Alpha>
 {
+	using storage_type = typename Storage::template state<T, std::size_t(1) << Alpha>;
+
 public:
 	using result_type = T;
 
+	static constexpr std::size_t alpha = Alpha;
+
 protected:
 	static constexpr std::size_t state_size = 1 << Alpha;
 
+	static constexpr std::size_t word_size = sizeof(result_type);
+
 	static constexpr result_type default_seed = 0;
 
 	explicit _isaac(result_type s)
@@ -74,21 +303,61 @@ protected:
 		seed(dev);
 	}
 
-	_isaac(const _isaac& rhs)
+	/*
+		For the allocator-extended constructors of isaac and isaac64, which
+		seed the engine afterward, or make it a copy of rhs. The state is
+		allocated from alloc, so the storage policy must be allocator-based.
+	*/
+	template<class Alloc>
+	_isaac(std::allocator_arg_t, const Alloc& alloc)
+	:
+	storage_type(alloc)
+	{}
+
+	template<class Alloc>
+	_isaac(std::allocator_arg_t, const Alloc& alloc, const _isaac& rhs)
+	:
+	storage_type(alloc),
+	a_(rhs.a_),
+	b_(rhs.b_),
+	c_(rhs.c_),
+	count_(rhs.count_),
+	byte_count_(rhs.byte_count_)
 	{
-		for (std::size_t i = 0; i < state_size; ++i)
-		{
-			result_[i] = rhs.result_[i];
-			memory_[i] = rhs.memory_[i];
-		}
-		a_ = rhs.a_;
-		b_ = rhs.b_;
-		c_ = rhs.c_;
-		count_ = rhs.count_;
+		std::copy(rhs.result_, rhs.result_ + state_size, result_);
+		std::copy(rhs.memory_, rhs.memory_ + state_size, memory_);
 	}
 
+	/*
+		The implicit copy and move operations are used. With the default
+		storage, engines are trivially copyable: they can be copied with memcpy,
+		and stored in memory-mapped files (see isaac_file_bank.h).
+	*/
+
 public:
 
+	/*
+		A read-only view of results held inside the engine, as returned by lease().
+	*/
+	struct block_view
+	{
+		const result_type* data;
+		std::size_t size;
+
+		const result_type* begin() const { return data; }
+		const result_type* end() const { return data + size; }
+	};
+
+	/*
+		Returns the allocator of an engine with allocator-based storage.
+	*/
+	template<class S = storage_type>
+	auto
+	get_allocator() const -> decltype(std::declval<const S&>().get_allocator())
+	{
+		return storage_type::get_allocator();
+	}
+
 	static constexpr result_type min()
 	{
 		return std::numeric_limits<result_type>::min();
@@ -140,25 +409,37 @@ public:
 		init();
 	}
 	
+	/*
+		Each word of the seed takes as many calls to dev() as it has 32-bit halves.
+		See isaac_entropy.h for a faster source of entropy.
+	*/
 	void
 	seed(std::random_device& dev)
 	{
-        std::vector<result_type> seed_vec;
-        seed_vec.reserve(state_size);
-        for (auto i = 0; i < state_size; ++i)
-        {
-			result_type value;
-			value = dev();
-            std::size_t bytes_filled{sizeof(std::random_device::result_type)};
-			while(bytes_filled < sizeof(result_type))
+		for (std::size_t i = 0; i < state_size; ++i)
+		{
+			result_type value = dev();
+			std::size_t bytes_filled{sizeof(std::random_device::result_type)};
+			while (bytes_filled < sizeof(result_type))
 			{
 				value <<= (sizeof(std::random_device::result_type) * 8);
 				value |= dev();
 				bytes_filled += sizeof(std::random_device::result_type);
 			}
-            seed_vec.push_back(value);
-        }
-        seed(seed_vec.begin(), seed_vec.end());		
+			result_[i] = value;
+		}
+		init();
+	}
+
+	/*
+		The number of values consumed since the engine was seeded. It is derived
+		from c_, which counts the blocks generated, so keeping track of it costs
+		nothing. For isaac, c_ is 32 bits wide, so the position wraps after 2^32 blocks.
+	*/
+	inline std::uint64_t
+	position() const
+	{
+		return static_cast<std::uint64_t>(c_) * state_size - count_;
 	}
 
 	inline result_type
@@ -167,25 +448,157 @@ public:
 		return (!count_--) ? (do_isaac(), count_ = state_size - 1, result_[count_]) : result_[count_];
 	}
 	
+	/*
+		Skips z values. Blocks that would be consumed entirely are generated
+		but never read, and the remainder is skipped by adjusting count_.
+	*/
 	inline void
 	discard(unsigned long long z)
 	{
-		for (; z; --z) operator()();
+		if (z <= count_)
+		{
+			count_ -= z;
+			return;
+		}
+		z -= count_;
+		count_ = 0;
+		for (; z >= state_size; z -= state_size)
+		{
+			do_isaac();
+		}
+		if (z > 0)
+		{
+			do_isaac();
+			count_ = state_size - z;
+		}
+	}
+
+	/*
+		Fills [first, last) with the next values in the sequence. The result
+		is identical to assigning operator()() to each element in turn, but whole
+		blocks of results are copied at once rather than one call per value.
+	*/
+	template<class ForwardIt>
+	inline void
+	generate(ForwardIt first, ForwardIt last)
+	{
+		copy_results(first, static_cast<std::size_t>(std::distance(first, last)));
+	}
+
+	inline void
+	generate(result_type* dest, std::size_t n)
+	{
+		copy_results(dest, n);
+	}
+
+	/*
+		As lease(), but the view is empty if the current block is used up; the
+		engine isn't modified, so it can be called on a shared, const engine.
+	*/
+	inline block_view
+	peek() const
+	{
+		return block_view{result_, count_};
+	}
+
+	/*
+		Returns a view of the results that have not yet been consumed, generating
+		a new block first if the current one is used up, so the view is never empty.
+		These are the values operator()() would return next, but in reverse order,
+		since operator()() reads from the end of the block. Nothing is consumed
+		until release() is called. The view is invalidated by any other call that
+		modifies the engine.
+	*/
+	inline block_view
+	lease()
+	{
+		if (count_ == 0)
+		{
+			do_isaac();
+			count_ = state_size;
+		}
+		return block_view{result_, count_};
+	}
+
+	/*
+		Marks the results returned by lease() as consumed. The next block is
+		generated by the following call to lease() (or any other generating call),
+		which leaves the engine in exactly the state operator()() would.
+	*/
+	inline void
+	release()
+	{
+		count_ = 0;
+	}
+
+	/*
+		Fills count bytes at dest from the sequence. Bytes are taken from each
+		result in memory order, and the unused bytes of a partially consumed result
+		are kept for the next call to fill_bytes(), so no output is thrown away.
+		Any of the other generating methods skips those leftover bytes, as does
+		writing the engine to a stream; save() keeps them.
+	*/
+	void
+	fill_bytes(void* dest, std::size_t count)
+	{
+		if (count == 0)
+		{
+			return;
+		}
+		unsigned char* out = static_cast<unsigned char*>(dest);
+		std::size_t spare = spare_bytes();
+		if (spare > 0)
+		{
+			std::size_t n = std::min(count, spare);
+			std::memcpy(out, reinterpret_cast<const unsigned char*>(result_ + count_) + (word_size - spare), n);
+			byte_count_ -= n;
+			out += n;
+			count -= n;
+		}
+		while (count >= word_size)
+		{
+			if (count_ == 0)
+			{
+				do_isaac();
+				count_ = state_size;
+			}
+			std::size_t n = std::min(count / word_size, count_);
+			for (std::size_t i = 0; i < n; ++i)
+			{
+				std::memcpy(out, result_ + (--count_), word_size);
+				out += word_size;
+			}
+			count -= n * word_size;
+		}
+		if (count > 0)
+		{
+			if (count_ == 0)
+			{
+				do_isaac();
+				count_ = state_size;
+			}
+			--count_;
+			std::memcpy(out, result_ + count_, count);
+			byte_count_ = count_ * word_size + (word_size - count);
+		}
 	}
 
 	friend bool
 	operator==(const _isaac& x, const _isaac& y)
 	{
 		bool equal = true;
-		if (x.a_ != y.a_ || x.b_ != y.b_ || x.c_ != y.c_ || x.count_ != y.count_)
+		if (x.a_ != y.a_ || x.b_ != y.b_ || x.c_ != y.c_ || x.count_ != y.count_ ||
+			x.spare_bytes() != y.spare_bytes())
 		{
 			equal = false;
 		}
 		else
 		{
+			// results that have already been consumed don't affect the sequence
+			std::size_t live = x.count_ + (x.spare_bytes() > 0 ? 1 : 0);
 			for (std::size_t i = 0; i < state_size; ++i)
 			{
-				if (x.result_[i] != y.result_[i] || x.memory_[i] != y.memory_[i])
+				if ((i < live && x.result_[i] != y.result_[i]) || x.memory_[i] != y.memory_[i])
 				{
 					equal = false;
 					break;
@@ -201,6 +614,82 @@ public:
 		return !(x == y);
 	}
 
+	/*
+		Binary snapshots. The layout is fixed, and doesn't depend on the host:
+
+			offset 0	"ISAC"
+			4		format version (1)
+			5		word size in bytes (4 for isaac, 8 for isaac64)
+			6		Alpha
+			7		leftover bytes from fill_bytes()
+			8		count_, 32 bits
+			12		reserved, zero
+			16		result_[state_size]
+					memory_[state_size]
+					a_, b_, c_
+
+		All integers are little-endian, so on little-endian hosts the state
+		is copied as is.
+	*/
+	static constexpr std::size_t
+	snapshot_size()
+	{
+		return snapshot_header_size + (2 * state_size + 3) * word_size;
+	}
+
+	/*
+		Writes snapshot_size() bytes to dest.
+	*/
+	void
+	save(void* dest) const
+	{
+		unsigned char* p = static_cast<unsigned char*>(dest);
+		p[0] = 'I';
+		p[1] = 'S';
+		p[2] = 'A';
+		p[3] = 'C';
+		p[4] = snapshot_version;
+		p[5] = static_cast<unsigned char>(word_size);
+		p[6] = static_cast<unsigned char>(Alpha);
+		p[7] = static_cast<unsigned char>(spare_bytes());
+		store_le(p + 8, static_cast<std::uint32_t>(count_));
+		store_le(p + 12, std::uint32_t(0));
+		p += snapshot_header_size;
+		p = store_le(p, result_, state_size);
+		p = store_le(p, memory_, state_size);
+		p = store_le(p, a_);
+		p = store_le(p, b_);
+		store_le(p, c_);
+	}
+
+	/*
+		Restores the state from a snapshot written by save(). Returns false,
+		leaving the engine unchanged, if the snapshot was written by an engine
+		of a different type or version, or is inconsistent.
+	*/
+	bool
+	load(const void* src)
+	{
+		const unsigned char* p = static_cast<const unsigned char*>(src);
+		std::uint32_t count = load_le<std::uint32_t>(p + 8);
+		std::size_t spare = p[7];
+		if (p[0] != 'I' || p[1] != 'S' || p[2] != 'A' || p[3] != 'C' || p[4] != snapshot_version ||
+			p[5] != word_size || p[6] != Alpha || count > state_size ||
+			spare >= word_size || (spare > 0 && count == state_size))
+		{
+			return false;
+		}
+		p += snapshot_header_size;
+		p = load_le(p, result_, state_size);
+		p = load_le(p, memory_, state_size);
+		a_ = load_le<result_type>(p);
+		b_ = load_le<result_type>(p + word_size);
+		c_ = load_le<result_type>(p + 2 * word_size);
+		count_ = count;
+		byte_count_ = count_ * word_size + spare;
+		return true;
+	}
+
 	template <class CharT, class Traits>
 	friend std::basic_ostream<CharT, Traits>&
 	operator<<(std::basic_ostream<CharT, Traits>& os, const _isaac& x)
@@ -303,6 +792,7 @@ public:
 			x.b_ = tmp_b;
 			x.c_ = tmp_c;
 			x.count_ = tmp_count;
+			x.byte_count_ = tmp_count * word_size;
 		}
 		else
 		{
@@ -316,24 +806,20 @@ protected:
 	void
 	init()
 	{
-		result_type a = golden();
-		result_type b = golden();
-		result_type c = golden();
-		result_type d = golden();
-		result_type e = golden();
-		result_type f = golden();
-		result_type g = golden();
-		result_type h = golden();
+		const result_type* scrambled = golden_mix();	/* the golden ratio, scrambled */
+		result_type a = scrambled[0];
+		result_type b = scrambled[1];
+		result_type c = scrambled[2];
+		result_type d = scrambled[3];
+		result_type e = scrambled[4];
+		result_type f = scrambled[5];
+		result_type g = scrambled[6];
+		result_type h = scrambled[7];
 		
 		a_ = 0;
 		b_ = 0;
 		c_ = 0;
 		
-		for (std::size_t i = 0; i < 4; ++i)          /* scramble it */
-		{
-			mix(a,b,c,d,e,f,g,h);
-		}
-		
 		/* initialize using the contents of result_[] as the seed */
 		for (std::size_t i = 0; i < state_size; i += 8)
 		{
@@ -386,16 +872,155 @@ protected:
 		count_ = state_size;	/* prepare to use the first set of results */
 	}
 	
+	/*
+		operator()() consumes result_ from the top down, so blocks are copied
+		out in reverse to preserve the order of the sequence.
+	*/
+	template<class OutputIt>
+	OutputIt
+	copy_results(OutputIt out, std::size_t n)
+	{
+		std::size_t k = std::min(n, count_);
+		out = std::reverse_copy(result_ + count_ - k, result_ + count_, out);
+		count_ -= k;
+		n -= k;
+		while (n >= state_size)
+		{
+			do_isaac();
+			out = std::reverse_copy(result_, result_ + state_size, out);
+			n -= state_size;
+		}
+		if (n > 0)
+		{
+			do_isaac();
+			count_ = state_size - n;
+			out = std::reverse_copy(result_ + count_, result_ + state_size, out);
+		}
+		return out;
+	}
+
+	/*
+		When the destination is contiguous, whole blocks are generated directly
+		into it, so each value is written exactly once.
+	*/
+	result_type*
+	copy_results(result_type* out, std::size_t n)
+	{
+		std::size_t k = std::min(n, count_);
+		out = std::reverse_copy(result_ + count_ - k, result_ + count_, out);
+		count_ -= k;
+		n -= k;
+		while (n >= state_size)
+		{
+			do_isaac(out);
+			out += state_size;
+			n -= state_size;
+		}
+		if (n > 0)
+		{
+			do_isaac();
+			count_ = state_size - n;
+			out = std::reverse_copy(result_ + count_, result_ + state_size, out);
+		}
+		return out;
+	}
+
 	inline void
 	do_isaac()
 	{
-		static_cast<Derived*>(this)->_do_isaac();
+		static_cast<Derived*>(this)->template _do_isaac<1>(result_);
+		byte_count_ = 0;
+	}
+
+	/*
+		Writes the next block directly to dest, in the order operator()() would
+		return it, without going through result_. Whatever is left in result_ is
+		stale afterwards, so the block counts as fully consumed.
+	*/
+	inline void
+	do_isaac(result_type* dest)
+	{
+		static_cast<Derived*>(this)->template _do_isaac<-1>(dest + state_size);
+		count_ = 0;
+		byte_count_ = 0;
+	}
+
+	static constexpr std::size_t snapshot_header_size = 16;
+
+	static constexpr unsigned char snapshot_version = 1;
+
+	template<class U>
+	static unsigned char*
+	store_le(unsigned char* p, U value)
+	{
+		for (std::size_t i = 0; i < sizeof(U); ++i)
+		{
+			p[i] = static_cast<unsigned char>(value >> (8 * i));
+		}
+		return p + sizeof(U);
+	}
+
+	static unsigned char*
+	store_le(unsigned char* p, const result_type* words, std::size_t n)
+	{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+		std::memcpy(p, words, n * word_size);
+		return p + n * word_size;
+#else
+		for (std::size_t i = 0; i < n; ++i)
+		{
+			p = store_le(p, words[i]);
+		}
+		return p;
+#endif
+	}
+
+	template<class U>
+	static U
+	load_le(const unsigned char* p)
+	{
+		U value = 0;
+		for (std::size_t i = 0; i < sizeof(U); ++i)
+		{
+			value |= static_cast<U>(p[i]) << (8 * i);
+		}
+		return value;
+	}
+
+	static const unsigned char*
+	load_le(const unsigned char* p, result_type* words, std::size_t n)
+	{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+		std::memcpy(words, p, n * word_size);
+		return p + n * word_size;
+#else
+		for (std::size_t i = 0; i < n; ++i)
+		{
+			words[i] = load_le<result_type>(p);
+			p += word_size;
+		}
+		return p;
+#endif
+	}
+
+	/*
+		byte_count_ is only meaningful while it agrees with count_; any call that
+		consumes whole results moves count_ and thereby drops the leftover bytes.
+	*/
+	inline std::size_t
+	spare_bytes() const
+	{
+		return (byte_count_ / word_size == count_) ? byte_count_ % word_size : 0;
 	}
 	
-	inline result_type
-	golden()
+	/*
+		Eight copies of the golden ratio after four rounds of mix(), with which
+		init() starts. They don't depend on the seed, so they are precomputed.
+	*/
+	static inline const result_type*
+	golden_mix()
 	{
-		return static_cast<Derived*>(this)->_golden();
+		return Derived::_golden_mix();
 	}
 	
 	inline void
@@ -404,23 +1029,41 @@ protected:
 		static_cast<Derived*>(this)->_mix(a, b, c, d, e, f, g, h);
 	}
 	
-	result_type result_[state_size];
-	result_type memory_[state_size];
+	/*
+		Takes steps first to last - 1 of generating the next block, writing
+		result i to dest[i], so a block can be generated a few steps at a time.
+		a_ and b_ carry the running values from one range to the next: the
+		caller starts a block by adding ++c_ to b_, and after the last step
+		the state is as do_isaac() would leave it.
+	*/
+	inline void
+	do_isaac_steps(result_type* dest, std::size_t first, std::size_t last)
+	{
+		static_cast<Derived*>(this)->_do_isaac_steps(dest, first, last);
+	}
+
+	template<class, std::size_t, class, std::size_t> friend class _isaac_lanes;
+	template<class> friend class checkpoint_index;
+	template<class, std::size_t> friend class isaac_incremental;
+
+	using storage_type::result_;
+	using storage_type::memory_;
 	result_type a_;
 	result_type b_;
 	result_type c_;
 	std::size_t count_;
+	std::size_t byte_count_;	/* count_ * word_size plus unread bytes in result_[count_], for fill_bytes() */
 };
 
 
-template<std::size_t Alpha = 8>
-class isaac : public _isaac<isaac<Alpha>, Alpha, std::uint32_t>
+template<std::size_t Alpha = 8, class Storage = isaac_inline_storage>
+class isaac : public _isaac<isaac<Alpha, Storage>, Alpha, std::uint32_t, Storage>
 {
 public:
 
-	using base = _isaac<isaac, Alpha, std::uint32_t>;
+	using base = _isaac<isaac, Alpha, std::uint32_t, Storage>;
 	
-	friend class _isaac<isaac, Alpha, std::uint32_t>;
+	friend class _isaac<isaac, Alpha, std::uint32_t, Storage>;
 	
 	using result_type = std::uint32_t;
 	
@@ -448,16 +1091,63 @@ public:
 	base::_isaac(dev)
 	{}
 
-	isaac(const isaac& rhs)
+	/*
+		Allocator-extended constructors, for engines with allocator-based
+		storage: the state is allocated from alloc, and then seeded as by
+		the constructors above, or copied from rhs.
+	*/
+	template<class Alloc>
+	isaac(std::allocator_arg_t tag, const Alloc& alloc, result_type s = base::default_seed)
+	:
+	base::_isaac(tag, alloc)
+	{
+		base::seed(s);
+	}
+
+	template<class Alloc, class Sseq>
+	isaac(std::allocator_arg_t tag, const Alloc& alloc, Sseq& q, typename std::enable_if<std::__is_seed_sequence<Sseq, isaac>::value>::type* = 0)
+	:
+	base::_isaac(tag, alloc)
+	{
+		base::seed(q);
+	}
+
+	template<class Alloc, class Iter>
+	isaac(std::allocator_arg_t tag, const Alloc& alloc, Iter begin, Iter end, typename std::enable_if <
+		  std::is_integral<typename std::iterator_traits<Iter>::value_type>::value &&
+		  std::is_unsigned<typename std::iterator_traits<Iter>::value_type>::value>::type * = nullptr)
 	:
-	base::_isaac(static_cast<const base&>(rhs))
+	base::_isaac(tag, alloc)
+	{
+		base::seed(begin, end);
+	}
+
+	template<class Alloc>
+	isaac(std::allocator_arg_t tag, const Alloc& alloc, std::random_device& dev)
+	:
+	base::_isaac(tag, alloc)
+	{
+		base::seed(dev);
+	}
+
+	template<class Alloc>
+	isaac(std::allocator_arg_t tag, const Alloc& alloc, const isaac& rhs)
+	:
+	base::_isaac(tag, alloc, rhs)
 	{}
 
 private:
 	
-	static constexpr result_type _golden()
+	static const result_type*
+	_golden_mix()
 	{
-		return 0x9e3779b9; /* the golden ratio */
+		/* mix() applied four times to eight copies of 0x9e3779b9, the golden ratio */
+		static constexpr result_type table[8] =
+		{
+			0x1367df5a, 0x95d90059, 0xc3163e4b, 0x0f421ad8,
+			0xd92a4a78, 0xa51a3c49, 0xc4efea1b, 0x30609119
+		};
+		return table;
 	}
 
 	inline void
@@ -479,6 +1169,7 @@ private:
 		return *(result_type *)((std::uint8_t *)(mm) + ((x) & ((base::state_size - 1) << 2)));
 	}
 
+	template<std::ptrdiff_t Stride>
 	inline void
 	rngstep(const result_type mix, result_type& a, result_type& b, result_type*& mm,
 			result_type*& m, result_type*& m2, result_type*& r, result_type& x, result_type& y)
@@ -486,11 +1177,24 @@ private:
 	  x = *m;
 	  a = (a^(mix)) + *(m2++);
 	  *(m++) = y = ind(mm, x) + a + b;
-	  *(r++) = b = ind(mm, y >> Alpha) + x;
+	  b = ind(mm, y >> Alpha) + x;
+	  if (Stride < 0)
+	  {
+		  *(--r) = b;
+	  }
+	  else
+	  {
+		  *(r++) = b;
+	  }
 	}
 
+	/*
+		Results are written forwards from r if Stride is positive, and otherwise
+		backwards from just before r, so r never leaves the block it fills.
+	*/
+	template<std::ptrdiff_t Stride>
 	void
-	_do_isaac()
+	_do_isaac(result_type* r)
 	{
 		result_type a;
 		result_type b;
@@ -499,42 +1203,69 @@ private:
 		result_type * m;
 		result_type * mm;
 		result_type * m2;
-		result_type * r;
 		result_type * mend;
 		
 		mm = base::memory_;
-		r = base::result_;
 		a = base::a_;
 		b = base::b_ + (++base::c_);
 		for (m = mm, mend = m2 = m + (base::state_size/2); m < mend; )
 		{
-			rngstep( a << 13, a, b, mm, m, m2, r, x, y);
-			rngstep( a >> 6 , a, b, mm, m, m2, r, x, y);
-			rngstep( a << 2 , a, b, mm, m, m2, r, x, y);
-			rngstep( a >> 16, a, b, mm, m, m2, r, x, y);
+			rngstep<Stride>( a << 13, a, b, mm, m, m2, r, x, y);
+			rngstep<Stride>( a >> 6 , a, b, mm, m, m2, r, x, y);
+			rngstep<Stride>( a << 2 , a, b, mm, m, m2, r, x, y);
+			rngstep<Stride>( a >> 16, a, b, mm, m, m2, r, x, y);
 		}
 		for (m2 = mm; m2 < mend; )
 		{
-			rngstep( a << 13, a, b, mm, m, m2, r, x, y);
-			rngstep( a >> 6 , a, b, mm, m, m2, r, x, y);
-			rngstep( a << 2 , a, b, mm, m, m2, r, x, y);
-			rngstep( a >> 16, a, b, mm, m, m2, r, x, y);
+			rngstep<Stride>( a << 13, a, b, mm, m, m2, r, x, y);
+			rngstep<Stride>( a >> 6 , a, b, mm, m, m2, r, x, y);
+			rngstep<Stride>( a << 2 , a, b, mm, m, m2, r, x, y);
+			rngstep<Stride>( a >> 16, a, b, mm, m, m2, r, x, y);
 		}
 		base::b_ = b; base::a_ = a;
 	}
 
+	/*
+		The steps of _do_isaac<1>, one at a time: step i updates memory_[i]
+		from memory_[i ^ (state_size / 2)], with the shift that i % 4 selects.
+	*/
+	void
+	_do_isaac_steps(result_type* r, std::size_t first, std::size_t last)
+	{
+		result_type* mm = base::memory_;
+		result_type a = base::a_;
+		result_type b = base::b_;
+		for (std::size_t i = first; i < last; ++i)
+		{
+			result_type mix;
+			switch (i & 3)
+			{
+			case 0: mix = a << 13; break;
+			case 1: mix = a >> 6; break;
+			case 2: mix = a << 2; break;
+			default: mix = a >> 16; break;
+			}
+			result_type x = mm[i];
+			a = (a ^ mix) + mm[i ^ (base::state_size / 2)];
+			result_type y = mm[i] = ind(mm, x) + a + b;
+			r[i] = b = ind(mm, y >> Alpha) + x;
+		}
+		base::a_ = a;
+		base::b_ = b;
+	}
+
 };
 
-template<std::size_t Alpha = 8>
-class isaac64 : public _isaac<isaac64<Alpha>, Alpha, std::uint64_t>
+template<std::size_t Alpha = 8, class Storage = isaac_inline_storage>
+class isaac64 : public _isaac<isaac64<Alpha, Storage>, Alpha, std::uint64_t, Storage>
 {
 public:
 	
 	using result_type = std::uint64_t;
 
-	using base = _isaac<isaac64, Alpha, std::uint64_t>;
+	using base = _isaac<isaac64, Alpha, std::uint64_t, Storage>;
 
-	friend class _isaac<isaac64, Alpha, std::uint64_t>;
+	friend class _isaac<isaac64, Alpha, std::uint64_t, Storage>;
 	
 	explicit isaac64(result_type s = base::default_seed)
 	:
@@ -564,16 +1295,63 @@ public:
     base::_isaac(dev)
     {}
 
-	isaac64(const isaac64& rhs)
+	/*
+		Allocator-extended constructors, for engines with allocator-based
+		storage: the state is allocated from alloc, and then seeded as by
+		the constructors above, or copied from rhs.
+	*/
+	template<class Alloc>
+	isaac64(std::allocator_arg_t tag, const Alloc& alloc, result_type s = base::default_seed)
 	:
-	base::_isaac(static_cast<const base&>(rhs))
+	base::_isaac(tag, alloc)
+	{
+		base::seed(s);
+	}
+
+	template<class Alloc, class Sseq>
+	isaac64(std::allocator_arg_t tag, const Alloc& alloc, Sseq& q, typename std::enable_if<std::__is_seed_sequence<Sseq, isaac64>::value>::type* = 0)
+	:
+	base::_isaac(tag, alloc)
+	{
+		base::seed(q);
+	}
+
+	template<class Alloc, class Iter>
+	isaac64(std::allocator_arg_t tag, const Alloc& alloc, Iter begin, Iter end, typename std::enable_if <
+		  std::is_integral<typename std::iterator_traits<Iter>::value_type>::value &&
+		  std::is_unsigned<typename std::iterator_traits<Iter>::value_type>::value>::type * = nullptr)
+	:
+	base::_isaac(tag, alloc)
+	{
+		base::seed(begin, end);
+	}
+
+	template<class Alloc>
+	isaac64(std::allocator_arg_t tag, const Alloc& alloc, std::random_device& dev)
+	:
+	base::_isaac(tag, alloc)
+	{
+		base::seed(dev);
+	}
+
+	template<class Alloc>
+	isaac64(std::allocator_arg_t tag, const Alloc& alloc, const isaac64& rhs)
+	:
+	base::_isaac(tag, alloc, rhs)
 	{}
 
 private:
 
-	static constexpr result_type _golden()
+	static const result_type*
+	_golden_mix()
 	{
-		return 0x9e3779b97f4a7c13LL; /* the golden ratio */
+		/* mix() applied four times to eight copies of 0x9e3779b97f4a7c13, the golden ratio */
+		static constexpr result_type table[8] =
+		{
+			0x647c4677a2884b7cULL, 0xb9f8b322c73ac862ULL, 0x8c0ea5053d4712a0ULL, 0xb29b2e824a595524ULL,
+			0x82f053db8355e0ceULL, 0x48fe4a0fa5a09315ULL, 0xae985bf2cbfc89edULL, 0x98f5704f6c44c0abULL
+		};
+		return table;
 	}
 
 	inline void
@@ -595,6 +1373,7 @@ private:
 		return *(result_type *)((std::uint8_t *)(mm) + ((x) & ((base::state_size - 1) << 3)));
 	}
 
+	template<std::ptrdiff_t Stride>
 	inline void
 	rngstep(const result_type mix, result_type& a, result_type& b, result_type*& mm,
 			result_type*& m, result_type*& m2, result_type*& r, result_type& x, result_type& y)
@@ -602,11 +1381,24 @@ private:
 	  x = *m;
 	  a = (mix) + *(m2++);
 	  *(m++) = y = ind(mm, x) + a + b;
-	  *(r++) = b = ind(mm, y >> Alpha) + x;
+	  b = ind(mm, y >> Alpha) + x;
+	  if (Stride < 0)
+	  {
+		  *(--r) = b;
+	  }
+	  else
+	  {
+		  *(r++) = b;
+	  }
 	}
 
+	/*
+		Results are written forwards from r if Stride is positive, and otherwise
+		backwards from just before r, so r never leaves the block it fills.
+	*/
+	template<std::ptrdiff_t Stride>
 	void
-	_do_isaac()
+	_do_isaac(result_type* r)
 	{
 		result_type a;
 		result_type b;
@@ -615,32 +1407,217 @@ private:
 		result_type * m;
 		result_type * mm;
 		result_type * m2;
-		result_type * r;
 		result_type * mend;
 		
 		mm = base::memory_;
-		r = base::result_;
 		a = base::a_;
 		b = base::b_ + (++base::c_);
 		for (m = mm, mend = m2 = m + (base::state_size / 2); m < mend; )
 		{
-			rngstep(~(a ^ (a << 21)), a, b, mm, m, m2, r, x, y);
-			rngstep(a ^ (a >> 5), a, b, mm, m, m2, r, x, y);
-			rngstep(a ^ (a << 12), a, b, mm, m, m2, r, x, y);
-			rngstep(a ^ (a >> 33), a, b, mm, m, m2, r, x, y);
+			rngstep<Stride>(~(a ^ (a << 21)), a, b, mm, m, m2, r, x, y);
+			rngstep<Stride>(a ^ (a >> 5), a, b, mm, m, m2, r, x, y);
+			rngstep<Stride>(a ^ (a << 12), a, b, mm, m, m2, r, x, y);
+			rngstep<Stride>(a ^ (a >> 33), a, b, mm, m, m2, r, x, y);
 		}
 		for (m2 = mm; m2 < mend; )
 		{
-			rngstep(~(a^(a << 21)), a, b, mm, m, m2, r, x, y);
-			rngstep(a^(a >> 5), a, b, mm, m, m2, r, x, y);
-			rngstep(a^(a << 12), a, b, mm, m, m2, r, x, y);
-			rngstep(a^(a >> 33), a, b, mm, m, m2, r, x, y);
+			rngstep<Stride>(~(a^(a << 21)), a, b, mm, m, m2, r, x, y);
+			rngstep<Stride>(a^(a >> 5), a, b, mm, m, m2, r, x, y);
+			rngstep<Stride>(a^(a << 12), a, b, mm, m, m2, r, x, y);
+			rngstep<Stride>(a^(a >> 33), a, b, mm, m, m2, r, x, y);
 		}
 		base::b_ = b; base::a_ = a;
 	}
 
+	/*
+		The steps of _do_isaac<1>, one at a time: step i updates memory_[i]
+		from memory_[i ^ (state_size / 2)], with the mix that i % 4 selects.
+	*/
+	void
+	_do_isaac_steps(result_type* r, std::size_t first, std::size_t last)
+	{
+		result_type* mm = base::memory_;
+		result_type a = base::a_;
+		result_type b = base::b_;
+		for (std::size_t i = first; i < last; ++i)
+		{
+			result_type mix;
+			switch (i & 3)
+			{
+			case 0: mix = ~(a ^ (a << 21)); break;
+			case 1: mix = a ^ (a >> 5); break;
+			case 2: mix = a ^ (a << 12); break;
+			default: mix = a ^ (a >> 33); break;
+			}
+			result_type x = mm[i];
+			a = mix + mm[i ^ (base::state_size / 2)];
+			result_type y = mm[i] = ind(mm, x) + a + b;
+			r[i] = b = ind(mm, y >> Alpha) + x;
+		}
+		base::a_ = a;
+		base::b_ = b;
+	}
+
+};
+
+#if __cplusplus >= 201703L
+
+/*
+	Engines whose state is allocated from a std::pmr::memory_resource,
+	e.g. a per-request arena, given to the allocator-extended constructors:
+
+		std::pmr::monotonic_buffer_resource arena;
+		utils::pmr::isaac64<> gen(std::allocator_arg, &arena, seed);
+*/
+namespace pmr
+{
+	using isaac_storage = isaac_allocator_storage<std::pmr::polymorphic_allocator<unsigned char>>;
+
+	template<std::size_t Alpha = 8>
+	using isaac = utils::isaac<Alpha, isaac_storage>;
+
+	template<std::size_t Alpha = 8>
+	using isaac64 = utils::isaac64<Alpha, isaac_storage>;
+}
+
+#endif
+
+/************************************************************
+checkpoint_index records the state of one stream at regular
+block intervals, so that an engine can later be positioned
+anywhere in that stream by restoring the nearest earlier
+checkpoint and discarding forward, instead of regenerating
+everything from the seed. A checkpoint is taken at a block
+boundary, where result_ has been consumed, so it only holds
+memory_, a_, b_ and c_.
+*************************************************************/
+
+template<class Engine>
+class checkpoint_index
+{
+public:
+	using result_type = typename Engine::result_type;
+
+	/*
+		Indexes the stream of origin from its current position on, recording a
+		checkpoint every interval blocks. Checkpoints are recorded on demand, as
+		seek() or extend() reach further into the stream.
+	*/
+	checkpoint_index(const Engine& origin, std::size_t interval)
+	:
+	origin_(origin),
+	cursor_(origin),
+	interval_(interval > 0 ? interval : 1)
+	{
+		// the first checkpoint is at the end of the block the origin is in
+		cursor_.discard(cursor_.count_);
+		record();
+	}
+
+	/*
+		Records checkpoints until the last one is within interval blocks of position.
+	*/
+	void
+	extend(std::uint64_t position)
+	{
+		const std::uint64_t span = static_cast<std::uint64_t>(interval_) * state_size;
+		while (cursor_.position() + span <= position)
+		{
+			cursor_.discard(span);
+			record();
+		}
+	}
+
+	/*
+		Sets e to the state of the indexed stream at the given position. Returns
+		false, leaving e unchanged, if position precedes the origin.
+	*/
+	bool
+	seek(Engine& e, std::uint64_t position)
+	{
+		if (position < origin_.position())
+		{
+			return false;
+		}
+		if (position < first_position())
+		{
+			e = origin_;
+			e.discard(position - origin_.position());
+			return true;
+		}
+		extend(position);
+		std::size_t k = static_cast<std::size_t>((position - first_position()) / (static_cast<std::uint64_t>(interval_) * state_size));
+		const checkpoint& cp = checkpoints_[k];
+		std::copy(cp.memory, cp.memory + state_size, e.memory_);
+		e.a_ = cp.a;
+		e.b_ = cp.b;
+		e.c_ = cp.c;
+		e.count_ = 0;
+		e.byte_count_ = 0;
+		e.discard(position - e.position());
+		return true;
+	}
+
+	/*
+		The number of checkpoints recorded so far.
+	*/
+	std::size_t
+	size() const
+	{
+		return checkpoints_.size();
+	}
+
+private:
+
+	static constexpr std::size_t state_size = Engine::state_size;
+
+	struct checkpoint
+	{
+		result_type memory[state_size];
+		result_type a;
+		result_type b;
+		result_type c;
+	};
+
+	std::uint64_t
+	first_position() const
+	{
+		return static_cast<std::uint64_t>(checkpoints_.front().c) * state_size;
+	}
+
+	void
+	record()
+	{
+		checkpoints_.emplace_back();
+		checkpoint& cp = checkpoints_.back();
+		std::copy(cursor_.memory_, cursor_.memory_ + state_size, cp.memory);
+		cp.a = cursor_.a_;
+		cp.b = cursor_.b_;
+		cp.c = cursor_.c_;
+	}
+
+	Engine origin_;
+	Engine cursor_;
+	std::size_t interval_;
+	std::vector<checkpoint> checkpoints_;
 };
 
 }
 
+/*
+	Engines with allocator-based storage are allocator-aware, so containers
+	that pass their allocator on to their elements, such as std::pmr::vector,
+	construct them with the allocator-extended constructors.
+*/
+namespace std
+{
+	template<std::size_t Alpha, class A, class Alloc>
+	struct uses_allocator<utils::isaac<Alpha, utils::isaac_allocator_storage<A>>, Alloc> : is_convertible<Alloc, A>
+	{};
+
+	template<std::size_t Alpha, class A, class Alloc>
+	struct uses_allocator<utils::isaac64<Alpha, utils::isaac_allocator_storage<A>>, Alloc> : is_convertible<Alloc, A>
+	{};
+}
+
 #endif /* guard_utils_isaac_h */
@@ -0,0 +1,339 @@
+/*
+	ISAAC engines whose blocks are generated on another thread.
+
+	An engine generates a whole block of results in one call, every 2^Alpha calls, so
+	for isaac64<8> one call in 256 takes a few hundred times as long as the others, and
+	shows up in tail latency. An asynchronous engine keeps two or more blocks of
+	results, which a refill thread generates ahead of time; the consuming thread only
+	moves to the next block at the end of each one. One refill thread can serve many
+	engines. The sequence is that of the synchronous engine.
+*/
+
+#ifndef guard_utils_isaac_async_h
+#define guard_utils_isaac_async_h
+
+#include "isaac.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace utils
+{
+
+/*
+	An engine with blocks to refill, as queued on an isaac_refill_thread.
+*/
+class _isaac_refill_task
+{
+public:
+	virtual void refill() = 0;
+
+protected:
+	~_isaac_refill_task() = default;
+};
+
+/************************************************************
+isaac_refill_thread runs the refills of any number of
+isaac_async engines, one at a time, in the order they are
+requested. It must outlive the engines that use it. A
+request costs the consumer an uncontended lock, and, if the
+refill thread has been idle long enough to go to sleep, a
+wakeup.
+*************************************************************/
+
+class isaac_refill_thread
+{
+public:
+	isaac_refill_thread()
+	:
+	thread_([this]() { run(); })
+	{}
+
+	isaac_refill_thread(const isaac_refill_thread&) = delete;
+	isaac_refill_thread& operator=(const isaac_refill_thread&) = delete;
+
+	~isaac_refill_thread()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		wake_.notify_one();
+		thread_.join();
+	}
+
+	void
+	post(_isaac_refill_task* task)
+	{
+		bool sleeping;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			queue_.push_back(task);
+			queued_.store(true, std::memory_order_relaxed);
+			sleeping = sleeping_;
+		}
+		if (sleeping)
+		{
+			wake_.notify_one();
+		}
+	}
+
+private:
+
+	void
+	run()
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		for (;;)
+		{
+			if (queue_.empty() && !stop_ && spare_cpus())
+			{
+				lock.unlock();
+				poll();
+				lock.lock();
+			}
+			while (queue_.empty() && !stop_)
+			{
+				sleeping_ = true;
+				wake_.wait(lock);
+				sleeping_ = false;
+			}
+			if (queue_.empty())
+			{
+				return;
+			}
+			_isaac_refill_task* task = queue_.front();
+			queue_.pop_front();
+			queued_.store(!queue_.empty(), std::memory_order_relaxed);
+			lock.unlock();
+			task->refill();
+			lock.lock();
+		}
+	}
+
+	/*
+		Waits for a request for up to 200 us before going to sleep, yielding
+		to other threads meanwhile. While its engines are in use, the thread
+		therefore stays awake, and requesting a refill doesn't cost the
+		consumer a system call to wake it. With a single CPU, polling would
+		only take time from the consumers, so the thread sleeps at once.
+	*/
+	void
+	poll()
+	{
+		auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(200);
+		while (!queued_.load(std::memory_order_relaxed) && std::chrono::steady_clock::now() < until)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	static bool
+	spare_cpus()
+	{
+		static const bool spare = std::thread::hardware_concurrency() > 1;
+		return spare;
+	}
+
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	std::atomic<bool> queued_{false};
+	std::deque<_isaac_refill_task*> queue_;
+	bool sleeping_ = false;
+	bool stop_ = false;
+	std::thread thread_;
+};
+
+/************************************************************
+isaac_async<Engine, Blocks> produces the sequence of the
+Engine it is constructed from, from a ring of Blocks blocks
+of results. When the consumer finishes a block, it hands the
+block back to be refilled and moves to the next; it only
+waits if the refill thread has fallen a whole ring behind.
+The refills run on the given isaac_refill_thread, or else on
+a thread of the engine's own. The engine's state is only
+touched by the refill thread after construction, so, unlike
+other engines, isaac_async can't be copied, compared, or
+reseeded; construct a new one instead. Each engine is used
+by one consuming thread at a time, as usual.
+*************************************************************/
+
+template<class Engine, std::size_t Blocks = 2>
+class isaac_async : private _isaac_refill_task
+{
+public:
+	using engine_type = Engine;
+
+	using result_type = typename Engine::result_type;
+
+	static_assert(_isaac_new_aligns<Engine>::value, "before C++17, new doesn't align engines with isaac_aligned_storage");
+
+	static_assert(Blocks >= 2, "the consumer needs a block to read while another is refilled");
+
+	static constexpr result_type min()
+	{
+		return Engine::min();
+	}
+	static constexpr result_type max()
+	{
+		return Engine::max();
+	}
+
+	explicit isaac_async(result_type s = 0)
+	:
+	isaac_async(Engine(s))
+	{}
+
+	/*
+		Continues the sequence of e, with a refill thread of its own.
+	*/
+	explicit isaac_async(const Engine& e)
+	:
+	own_thread_(new isaac_refill_thread),
+	refiller_(own_thread_.get()),
+	engine_(e)
+	{
+		start();
+	}
+
+	/*
+		Continues the sequence of e, refilled by a shared thread.
+	*/
+	isaac_async(const Engine& e, isaac_refill_thread& refiller)
+	:
+	refiller_(&refiller),
+	engine_(e)
+	{
+		start();
+	}
+
+	isaac_async(const isaac_async&) = delete;
+	isaac_async& operator=(const isaac_async&) = delete;
+
+	~isaac_async()
+	{
+		while (pending_.load(std::memory_order_acquire) != 0)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	inline result_type
+	operator()()
+	{
+		if (count_ == 0)
+		{
+			next_block();
+		}
+		return data_[--count_];
+	}
+
+	/*
+		Skipped blocks are generated by the refill thread, as usual.
+	*/
+	void
+	discard(unsigned long long z)
+	{
+		while (z > count_)
+		{
+			z -= count_;
+			count_ = 0;
+			next_block();
+		}
+		count_ -= static_cast<std::size_t>(z);
+	}
+
+private:
+
+	static constexpr std::size_t state_size = std::size_t(1) << Engine::alpha;
+
+	/*
+		size is the number of results in the block, or zero while it is waiting
+		to be refilled. It is the only field shared between the threads: the
+		consumer sets it to zero when it has finished reading the block, and the
+		refill thread sets it when it has finished writing.
+	*/
+	struct block
+	{
+		std::atomic<std::size_t> size{0};
+		result_type words[state_size];
+	};
+
+	/*
+		Fills the ring before the first draw; the first block is the engine's
+		current one, which may be partly used.
+	*/
+	void
+	start()
+	{
+		refill_blocks();
+		data_ = ring_[0].words;
+		count_ = ring_[0].size.load(std::memory_order_relaxed);
+	}
+
+	/*
+		Hands the finished block back, and waits for the next one.
+	*/
+	void
+	next_block()
+	{
+		ring_[current_].size.store(0, std::memory_order_release);
+		pending_.fetch_add(1, std::memory_order_relaxed);
+		refiller_->post(this);
+		current_ = (current_ + 1) % Blocks;
+		std::size_t size;
+		while ((size = ring_[current_].size.load(std::memory_order_acquire)) == 0)
+		{
+			std::this_thread::yield();
+		}
+		data_ = ring_[current_].words;
+		count_ = size;
+	}
+
+	/*
+		Runs on the refill thread. A request may find nothing left to fill, if
+		an earlier one already filled its block.
+	*/
+	void
+	refill() override
+	{
+		refill_blocks();
+		pending_.fetch_sub(1, std::memory_order_release);
+	}
+
+	void
+	refill_blocks()
+	{
+		while (ring_[filling_].size.load(std::memory_order_acquire) == 0)
+		{
+			typename Engine::block_view results = engine_.lease();
+			std::copy(results.begin(), results.end(), ring_[filling_].words);
+			engine_.release();
+			ring_[filling_].size.store(results.size, std::memory_order_release);
+			filling_ = (filling_ + 1) % Blocks;
+		}
+	}
+
+	/* the consumer's */
+	const result_type* data_ = nullptr;
+	std::size_t count_ = 0;
+	std::size_t current_ = 0;
+	std::atomic<std::size_t> pending_{0};	/* requests not yet completed */
+
+	std::unique_ptr<isaac_refill_thread> own_thread_;
+	isaac_refill_thread* refiller_;
+
+	/* the refill thread's */
+	Engine engine_;
+	std::size_t filling_ = 0;
+
+	block ring_[Blocks];
+};
+
+}
+
+#endif /* guard_utils_isaac_async_h */
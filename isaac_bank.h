@@ -0,0 +1,360 @@
+/*
+	Banks of ISAAC engines, stored structure-of-arrays.
+
+	A bank holds a large number of independently seeded engines, such as one per agent
+	of a simulation, in contiguous groups of multi-lane state (see isaac_lanes.h). Each
+	engine produces exactly the sequence of the scalar engine seeded the same way, but
+	drawing one value from every engine is a sequential pass over the bank, and the
+	engines of a group that run out together are refilled in one pass of the SIMD kernel.
+*/
+
+#ifndef guard_utils_isaac_bank_h
+#define guard_utils_isaac_bank_h
+
+#include "isaac_lanes.h"
+#include <memory>
+#include <new>
+#include <system_error>
+#include <thread>
+
+namespace utils
+{
+
+/************************************************************
+isaac_lanes_bank keeps its engines in groups of Lanes::lanes,
+engine i being lane i % lanes of group i / lanes, and counts
+the values left in each engine's current block separately,
+so engines can be used at different rates. A group is refilled
+with the multi-lane kernel when all of its engines are empty
+at once, which is always the case when every engine is drawn
+from equally, as by draw_all(); otherwise only the empty
+engines are refilled, one lane at a time.
+Use isaac_bank or isaac64_bank, below.
+*************************************************************/
+
+template<class Lanes>
+class isaac_lanes_bank
+{
+public:
+	using lanes_type = Lanes;
+
+	using engine_type = typename Lanes::engine_type;
+
+	using result_type = typename Lanes::result_type;
+
+	static constexpr std::size_t group_size = Lanes::lanes;
+
+	isaac_lanes_bank() = default;
+
+	/*
+		Engine i is seeded as the scalar engine constructed with the i-th seed.
+	*/
+	template<class Iter>
+	isaac_lanes_bank(Iter first, Iter last, typename std::enable_if<
+		std::is_integral<typename std::iterator_traits<Iter>::value_type>::value &&
+		std::is_unsigned<typename std::iterator_traits<Iter>::value_type>::value>::type * = nullptr)
+	{
+		seed(first, last);
+	}
+
+	explicit isaac_lanes_bank(const std::vector<result_type>& seeds, unsigned threads = 0)
+	{
+		seed(seeds.data(), seeds.size(), threads);
+	}
+
+	isaac_lanes_bank(const isaac_lanes_bank& rhs)
+	:
+	groups_(rhs.groups_ ? new group_storage[rhs.group_count()] : nullptr),
+	counts_(rhs.counts_),
+	size_(rhs.size_)
+	{
+		std::copy(rhs.groups_.get(), rhs.groups_.get() + rhs.group_count(), groups_.get());
+	}
+
+	isaac_lanes_bank(isaac_lanes_bank&& rhs) noexcept
+	:
+	groups_(std::move(rhs.groups_)),
+	counts_(std::move(rhs.counts_)),
+	size_(rhs.size_)
+	{
+		rhs.size_ = 0;
+	}
+
+	isaac_lanes_bank&
+	operator=(const isaac_lanes_bank& rhs)
+	{
+		if (this != &rhs)
+		{
+			*this = isaac_lanes_bank(rhs);
+		}
+		return *this;
+	}
+
+	isaac_lanes_bank&
+	operator=(isaac_lanes_bank&& rhs) noexcept
+	{
+		std::swap(groups_, rhs.groups_);
+		std::swap(counts_, rhs.counts_);
+		std::swap(size_, rhs.size_);
+		return *this;
+	}
+
+	template<class Iter>
+	typename std::enable_if<
+		std::is_integral<typename std::iterator_traits<Iter>::value_type>::value &&
+		std::is_unsigned<typename std::iterator_traits<Iter>::value_type>::value, void>::type
+	seed(Iter first, Iter last)
+	{
+		std::vector<result_type> seeds(first, last);
+		seed(seeds.data(), seeds.size());
+	}
+
+	/*
+		Seeds count engines, engine i with seeds[i]. The engines are seeded a
+		group at a time, with the key schedule vectorized across the lanes of
+		the group, and the groups are divided between up to threads threads;
+		by default, one per hardware thread. Each thread also touches the memory
+		of its groups first.
+	*/
+	void
+	seed(const result_type* seeds, std::size_t count, unsigned threads = 0)
+	{
+		seed_blocks(seeds, count, 1, threads);
+	}
+
+	/*
+		As seed(seeds, count, threads), but engine i is seeded with the
+		block_words words at blocks + i * block_words, as the scalar engine
+		seeded with that range.
+	*/
+	void
+	seed_blocks(const result_type* blocks, std::size_t count, std::size_t block_words, unsigned threads = 0)
+	{
+		size_ = count;
+		groups_.reset(count > 0 ? new group_storage[group_count()] : nullptr);
+		counts_.assign(group_count() * group_size, static_cast<std::uint32_t>(state_size));
+
+		std::size_t workers = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+		workers = std::max(std::size_t(1), std::min(workers, group_count() / min_groups_per_thread));
+		std::size_t per_worker = (group_count() + workers - 1) / workers;
+		std::vector<std::thread> pool;
+		pool.reserve(workers);
+		std::size_t first = per_worker;
+		for (; first < group_count(); first += per_worker)
+		{
+			std::size_t last = std::min(first + per_worker, group_count());
+			try
+			{
+				pool.emplace_back([=]() { seed_groups(first, last, blocks, block_words); });
+			}
+			catch (const std::system_error&)
+			{
+				/* no more threads can be started; the rest is seeded here */
+				break;
+			}
+		}
+		seed_groups(0, std::min(per_worker, group_count()), blocks, block_words);
+		if (first < group_count())
+		{
+			seed_groups(first, group_count(), blocks, block_words);
+		}
+		for (auto& t : pool)
+		{
+			t.join();
+		}
+	}
+
+	/*
+		Reseeds engine i alone.
+	*/
+	void
+	seed(std::size_t i, result_type s)
+	{
+		group(i / group_size).load_lane(i % group_size, engine_type(s));
+		counts_[i] = state_size;
+	}
+
+	std::size_t
+	size() const
+	{
+		return size_;
+	}
+
+	/*
+		Returns the next value of engine i.
+	*/
+	inline result_type
+	operator()(std::size_t i)
+	{
+		std::size_t g = i / group_size;
+		std::size_t l = i % group_size;
+		if (counts_[i] == 0)
+		{
+			refill(g);
+		}
+		return group(g).result_[(--counts_[i]) * group_size + l];
+	}
+
+	/*
+		Stores the next value of every engine in out[0 .. size()).
+	*/
+	void
+	draw_all(result_type* out)
+	{
+		for (std::size_t g = 0; g < group_count(); ++g)
+		{
+			std::uint32_t* counts = &counts_[g * group_size];
+			const result_type* results = group(g).result_;
+			std::size_t lanes = group_lanes(g);
+			if (std::all_of(counts + 1, counts + lanes, [=](std::uint32_t n) { return n == counts[0]; }))
+			{
+				/* the engines are in step, so their next values form one row */
+				if (counts[0] == 0)
+				{
+					refill(g);
+				}
+				std::size_t row = counts[0] - 1;
+				std::copy(results + row * group_size, results + row * group_size + lanes, out);
+				std::fill(counts, counts + lanes, static_cast<std::uint32_t>(row));
+			}
+			else
+			{
+				if (std::find(counts, counts + lanes, 0u) != counts + lanes)
+				{
+					refill(g);
+				}
+				for (std::size_t l = 0; l < lanes; ++l)
+				{
+					out[l] = results[(--counts[l]) * group_size + l];
+				}
+			}
+			out += lanes;
+		}
+	}
+
+	/*
+		Returns a scalar engine in the same state as engine i: the two produce
+		the same sequence from here on.
+	*/
+	engine_type
+	engine(std::size_t i) const
+	{
+		engine_type e;
+		group(i / group_size).store_lane(i % group_size, e, counts_[i]);
+		return e;
+	}
+
+private:
+
+	static constexpr std::size_t state_size = std::size_t(1) << engine_type::alpha;
+
+	/* below this many groups per thread, starting another thread costs more than it saves */
+	static constexpr std::size_t min_groups_per_thread = 64;
+
+	static_assert(std::is_trivially_copyable<Lanes>::value, "groups are stored as raw memory");
+
+	/*
+		Uninitialized memory for a group. The groups are constructed by the
+		threads that seed them, so that those threads touch their memory first.
+	*/
+	struct group_storage
+	{
+		alignas(Lanes) unsigned char bytes[sizeof(Lanes)];
+	};
+
+	std::size_t
+	group_count() const
+	{
+		return (size_ + group_size - 1) / group_size;
+	}
+
+	Lanes&
+	group(std::size_t g)
+	{
+		return *reinterpret_cast<Lanes*>(groups_[g].bytes);
+	}
+
+	const Lanes&
+	group(std::size_t g) const
+	{
+		return *reinterpret_cast<const Lanes*>(groups_[g].bytes);
+	}
+
+	/*
+		Seeds groups first to last - 1. The unused lanes of the last group are
+		seeded with zeros.
+	*/
+	void
+	seed_groups(std::size_t first, std::size_t last, const result_type* blocks, std::size_t block_words)
+	{
+		for (std::size_t g = first; g < last; ++g)
+		{
+			const result_type* words = blocks + g * group_size * block_words;
+			std::size_t lanes = group_lanes(g);
+			if (lanes < group_size)
+			{
+				std::vector<result_type> padded(group_size * block_words, 0);
+				std::copy(words, words + lanes * block_words, padded.begin());
+				new (groups_[g].bytes) Lanes(padded.data(), block_words);
+			}
+			else
+			{
+				new (groups_[g].bytes) Lanes(words, block_words);
+			}
+		}
+	}
+
+	/*
+		The number of engines in group g; the last group may have unused lanes,
+		which are stepped along with the others but never read.
+	*/
+	std::size_t
+	group_lanes(std::size_t g) const
+	{
+		std::size_t rest = size_ - g * group_size;
+		return rest < group_size ? rest : group_size;
+	}
+
+	/*
+		Refills the empty engines of group g: all of them in one pass of the
+		multi-lane kernel if every engine of the group is empty, or else one
+		at a time.
+	*/
+	void
+	refill(std::size_t g)
+	{
+		std::uint32_t* counts = &counts_[g * group_size];
+		std::size_t lanes = group_lanes(g);
+		if (std::all_of(counts, counts + lanes, [](std::uint32_t n) { return n == 0; }))
+		{
+			group(g).do_isaac();
+			std::fill(counts, counts + group_size, static_cast<std::uint32_t>(state_size));
+			return;
+		}
+		for (std::size_t l = 0; l < lanes; ++l)
+		{
+			if (counts[l] == 0)
+			{
+				group(g).do_isaac_lane(l);
+				counts[l] = state_size;
+			}
+		}
+	}
+
+	std::unique_ptr<group_storage[]> groups_;
+	std::vector<std::uint32_t> counts_;	/* values left in each engine's block, by engine */
+	std::size_t size_ = 0;
+};
+
+/*
+	The groups fill one AVX-512 register, or two AVX2 registers.
+*/
+template<std::size_t Alpha = 8>
+using isaac_bank = isaac_lanes_bank<isaac_x16<Alpha>>;
+
+template<std::size_t Alpha = 8>
+using isaac64_bank = isaac_lanes_bank<isaac64_x8<Alpha>>;
+
+}
+
+#endif /* guard_utils_isaac_bank_h */
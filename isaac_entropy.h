@@ -0,0 +1,287 @@
+/*
+	Seeding ISAAC engines from the operating system's entropy source.
+
+	std::random_device produces 32 bits per call, and each call may be a system call, so
+	seeding an isaac64<8> from one takes 512 of them. isaac_entropy reads the whole seed
+	in one request to the operating system, without allocating, and can also mix in the
+	output of the processor's hardware generator. POSIX only.
+*/
+
+#ifndef guard_utils_isaac_entropy_h
+#define guard_utils_isaac_entropy_h
+
+#include "isaac.h"
+#include <algorithm>
+#include <cerrno>
+#include <iterator>
+#include <unistd.h>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/random.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define UTILS_ISAAC_X86_ENTROPY
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace utils
+{
+
+/*
+	Fills buf with bytes bytes from the operating system: getrandom() on Linux,
+	getentropy() elsewhere. Returns false, with errno set, if it fails.
+*/
+inline bool
+os_entropy(void* buf, std::size_t bytes)
+{
+	unsigned char* p = static_cast<unsigned char*>(buf);
+#if defined(__linux__)
+	while (bytes > 0)
+	{
+		/* requests above 256 bytes can return early if a signal arrives */
+		ssize_t n = ::getrandom(p, bytes, 0);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+		p += n;
+		bytes -= static_cast<std::size_t>(n);
+	}
+#else
+	/* getentropy() is limited to 256 bytes per call */
+	while (bytes > 0)
+	{
+		std::size_t n = bytes < 256 ? bytes : 256;
+		if (::getentropy(p, n) != 0)
+		{
+			return false;
+		}
+		p += n;
+		bytes -= n;
+	}
+#endif
+	return true;
+}
+
+/*
+	The processor's generators, for isaac_entropy to mix in. RDSEED reads the
+	hardware entropy source, which is slow and can run dry briefly; RDRAND reads
+	a generator that the entropy source reseeds, and is about twenty times faster.
+*/
+enum class cpu_entropy
+{
+	none,
+	rdrand,
+	rdseed
+};
+
+#if defined(UTILS_ISAAC_X86_ENTROPY)
+
+#if defined(__x86_64__)
+using _cpu_entropy_word = unsigned long long;
+#else
+using _cpu_entropy_word = unsigned int;
+#endif
+
+inline bool
+_cpu_has(cpu_entropy source)
+{
+	unsigned int eax, ebx, ecx, edx;
+	if (source == cpu_entropy::rdseed)
+	{
+		return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_RDSEED) != 0;
+	}
+	return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_RDRND) != 0;
+}
+
+/*
+	Either instruction can fail transiently; RDSEED is retried with a pause
+	between attempts, as it fails whenever the entropy source falls behind.
+*/
+__attribute__((target("rdseed"))) inline bool
+_rdseed_word(_cpu_entropy_word& word)
+{
+	for (int i = 0; i < 100; ++i)
+	{
+#if defined(__x86_64__)
+		if (_rdseed64_step(&word))
+#else
+		if (_rdseed32_step(&word))
+#endif
+		{
+			return true;
+		}
+		_mm_pause();
+	}
+	return false;
+}
+
+__attribute__((target("rdrnd"))) inline bool
+_rdrand_word(_cpu_entropy_word& word)
+{
+	for (int i = 0; i < 10; ++i)
+	{
+#if defined(__x86_64__)
+		if (_rdrand64_step(&word))
+#else
+		if (_rdrand32_step(&word))
+#endif
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+#endif
+
+/*
+	XORs the output of the processor's generator into buf. Returns false,
+	leaving the rest of buf unchanged, if the processor lacks the instruction
+	or it keeps failing.
+*/
+inline bool
+cpu_entropy_mix(cpu_entropy source, void* buf, std::size_t bytes)
+{
+#if defined(UTILS_ISAAC_X86_ENTROPY)
+	if (source == cpu_entropy::none)
+	{
+		return true;
+	}
+	static const bool has_rdrand = _cpu_has(cpu_entropy::rdrand);
+	static const bool has_rdseed = _cpu_has(cpu_entropy::rdseed);
+	if (!(source == cpu_entropy::rdseed ? has_rdseed : has_rdrand))
+	{
+		return false;
+	}
+	unsigned char* p = static_cast<unsigned char*>(buf);
+	for (std::size_t i = 0; i < bytes; i += sizeof(_cpu_entropy_word))
+	{
+		_cpu_entropy_word word;
+		if (!(source == cpu_entropy::rdseed ? _rdseed_word(word) : _rdrand_word(word)))
+		{
+			return false;
+		}
+		std::size_t n = bytes - i < sizeof(word) ? bytes - i : sizeof(word);
+		for (std::size_t k = 0; k < n; ++k)
+		{
+			p[i + k] ^= static_cast<unsigned char>(word >> (8 * k));
+		}
+	}
+	return true;
+#else
+	(void)buf;
+	(void)bytes;
+	return source == cpu_entropy::none;
+#endif
+}
+
+/************************************************************
+isaac_entropy is passed to the constructors and seed() of
+isaac and isaac64 in place of a seed sequence, and fills the
+whole seed array, at the full width of the engine's words,
+with one request to the operating system. Given a source other
+than cpu_entropy::none, it also XORs in the output of that
+instruction, so the seed stays unpredictable if either source
+is. If the operating system's source fails, which only happens
+where it doesn't exist, std::random_device is used instead,
+which os_failed() reports. It isn't a full SeedSequence: it
+only supports generate().
+
+	utils::isaac_entropy entropy;
+	utils::isaac64<> engine(entropy);
+*************************************************************/
+
+class isaac_entropy
+{
+public:
+	using result_type = std::uint32_t;
+
+	explicit isaac_entropy(cpu_entropy mix = cpu_entropy::none)
+	:
+	mix_(mix)
+	{}
+
+	template<class T>
+	void
+	generate(T* first, T* last)
+	{
+		static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value, "seeds are unsigned integers");
+		std::size_t bytes = static_cast<std::size_t>(last - first) * sizeof(T);
+		if (!os_entropy(first, bytes))
+		{
+			os_failed_ = true;
+			std::random_device dev;
+			for (T* p = first; p != last; ++p)
+			{
+				*p = 0;
+				for (std::size_t filled = 0; filled < sizeof(T); filled += sizeof(std::random_device::result_type))
+				{
+					*p = static_cast<T>((static_cast<unsigned long long>(*p) << 16 << 16) | dev());
+				}
+			}
+		}
+		if (!cpu_entropy_mix(mix_, first, bytes))
+		{
+			cpu_failed_ = true;
+		}
+	}
+
+	/*
+		Iterators other than pointers are filled through a buffer, a block at a time.
+	*/
+	template<class Iter>
+	void
+	generate(Iter first, Iter last)
+	{
+		using value_type = typename std::iterator_traits<Iter>::value_type;
+		value_type block[256 / sizeof(value_type)];
+		while (first != last)
+		{
+			std::size_t n = 0;
+			for (Iter it = first; it != last && n < sizeof(block) / sizeof(block[0]); ++it)
+			{
+				++n;
+			}
+			generate(block, block + n);
+			first = std::copy(block, block + n, first);
+		}
+	}
+
+	/*
+		True if the operating system's source failed, so std::random_device
+		was used instead.
+	*/
+	bool
+	os_failed() const
+	{
+		return os_failed_;
+	}
+
+	/*
+		True if the processor's generator was requested, but the processor
+		lacks it, or it failed.
+	*/
+	bool
+	cpu_failed() const
+	{
+		return cpu_failed_;
+	}
+
+private:
+	cpu_entropy mix_;
+	bool os_failed_ = false;
+	bool cpu_failed_ = false;
+};
+
+}
+
+#undef UTILS_ISAAC_X86_ENTROPY
+
+#endif /* guard_utils_isaac_entropy_h */
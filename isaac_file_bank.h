@@ -0,0 +1,275 @@
+/*
+	A bank of ISAAC engines stored in a memory-mapped file.
+
+	The engines are kept in the file in their in-memory representation, back to back
+	after a small header, so a bank that is reopened is ready to use immediately, with
+	nothing to parse. Changes reach the file through the page cache, and sync() writes
+	them out, e.g. at a checkpoint. POSIX only.
+*/
+
+#ifndef guard_utils_isaac_file_bank_h
+#define guard_utils_isaac_file_bank_h
+
+#include "isaac.h"
+#include <string>
+#include <new>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace utils
+{
+
+/************************************************************
+isaac_file_bank maps a file holding count engines of type
+Engine (isaac<Alpha> or isaac64<Alpha>). The header records
+the word size, Alpha and the size of an engine, as well as the
+byte order of the host that created it, and open() refuses
+files that don't match the engine type, so an engine is never
+read with the wrong layout. The first engine starts on a 64-byte
+boundary, and the others follow it sizeof(Engine) bytes apart,
+so each is aligned as Engine requires (up to 64 bytes).
+The methods that can fail return false and leave errno set by
+the failing system call.
+*************************************************************/
+
+template<class Engine>
+class isaac_file_bank
+{
+public:
+	static_assert(std::is_trivially_copyable<Engine>::value, "engines must be trivially copyable to be stored in a file");
+
+	using engine_type = Engine;
+
+	isaac_file_bank() = default;
+
+	isaac_file_bank(const isaac_file_bank&) = delete;
+	isaac_file_bank& operator=(const isaac_file_bank&) = delete;
+
+	isaac_file_bank(isaac_file_bank&& rhs)
+	:
+	data_(rhs.data_),
+	bytes_(rhs.bytes_),
+	count_(rhs.count_)
+	{
+		rhs.data_ = nullptr;
+		rhs.bytes_ = 0;
+		rhs.count_ = 0;
+	}
+
+	isaac_file_bank&
+	operator=(isaac_file_bank&& rhs)
+	{
+		if (this != &rhs)
+		{
+			close();
+			std::swap(data_, rhs.data_);
+			std::swap(bytes_, rhs.bytes_);
+			std::swap(count_, rhs.count_);
+		}
+		return *this;
+	}
+
+	~isaac_file_bank()
+	{
+		close();
+	}
+
+	/*
+		Creates (or truncates) the file at path, sized for count engines, and maps
+		it. Every engine is initialized to a copy of prototype; typically, each is
+		then given its own seed.
+	*/
+	bool
+	create(const std::string& path, std::size_t count, const Engine& prototype = Engine())
+	{
+		close();
+		int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+		{
+			return false;
+		}
+		std::size_t bytes = file_size(count);
+		bool mapped = ::ftruncate(fd, static_cast<off_t>(bytes)) == 0 && map(fd, bytes);
+		::close(fd);
+		if (!mapped)
+		{
+			return false;
+		}
+
+		header* h = new (data_) header();
+		std::memcpy(h->magic, file_magic, sizeof(h->magic));
+		h->version = file_version;
+		h->byte_order = byte_order_mark;
+		h->word_size = sizeof(typename Engine::result_type);
+		h->alpha = Engine::alpha;
+		h->engine_size = sizeof(Engine);
+		h->count = count;
+
+		count_ = count;
+		for (std::size_t i = 0; i < count_; ++i)
+		{
+			new (slot(i)) Engine(prototype);
+		}
+		return true;
+	}
+
+	/*
+		Maps an existing bank file. Fails if the file wasn't created by
+		isaac_file_bank<Engine> on a host with the same byte order, or is truncated.
+	*/
+	bool
+	open(const std::string& path)
+	{
+		close();
+		int fd = ::open(path.c_str(), O_RDWR);
+		if (fd < 0)
+		{
+			return false;
+		}
+		struct stat st;
+		bool mapped = ::fstat(fd, &st) == 0 && static_cast<std::size_t>(st.st_size) >= header_size &&
+			map(fd, static_cast<std::size_t>(st.st_size));
+		::close(fd);
+		if (!mapped)
+		{
+			return false;
+		}
+
+		const header* h = reinterpret_cast<const header*>(data_);
+		if (std::memcmp(h->magic, file_magic, sizeof(h->magic)) != 0 ||
+			h->version != file_version ||
+			h->byte_order != byte_order_mark ||
+			h->word_size != sizeof(typename Engine::result_type) ||
+			h->alpha != Engine::alpha ||
+			h->engine_size != sizeof(Engine) ||
+			file_size(static_cast<std::size_t>(h->count)) != bytes_)
+		{
+			close();
+			errno = EINVAL;
+			return false;
+		}
+		count_ = static_cast<std::size_t>(h->count);
+		return true;
+	}
+
+	/*
+		Writes modified pages to the file. If wait is false, the writes are
+		scheduled and sync() returns without waiting for them to complete.
+	*/
+	bool
+	sync(bool wait = true)
+	{
+		return data_ == nullptr || ::msync(data_, bytes_, wait ? MS_SYNC : MS_ASYNC) == 0;
+	}
+
+	/*
+		Unmaps the file. Modified pages still reach the file eventually, but
+		only sync() guarantees when.
+	*/
+	void
+	close()
+	{
+		if (data_ != nullptr)
+		{
+			::munmap(data_, bytes_);
+			data_ = nullptr;
+			bytes_ = 0;
+			count_ = 0;
+		}
+	}
+
+	bool
+	is_open() const
+	{
+		return data_ != nullptr;
+	}
+
+	std::size_t
+	size() const
+	{
+		return count_;
+	}
+
+	Engine&
+	operator[](std::size_t i)
+	{
+		return *slot(i);
+	}
+
+	const Engine&
+	operator[](std::size_t i) const
+	{
+		return *slot(i);
+	}
+
+	Engine*
+	begin()
+	{
+		return data_ != nullptr ? slot(0) : nullptr;
+	}
+
+	Engine*
+	end()
+	{
+		return data_ != nullptr ? slot(count_) : nullptr;
+	}
+
+private:
+
+	struct header
+	{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t byte_order;
+		std::uint32_t word_size;
+		std::uint32_t alpha;
+		std::uint64_t engine_size;
+		std::uint64_t count;
+	};
+
+	static constexpr std::size_t header_size = 64;
+
+	static_assert(sizeof(header) <= header_size, "header doesn't fit");
+
+	static constexpr const char* file_magic = "ISACBANK";
+
+	static constexpr std::uint32_t file_version = 1;
+
+	static constexpr std::uint32_t byte_order_mark = 0x01020304;
+
+	static std::size_t
+	file_size(std::size_t count)
+	{
+		return header_size + count * sizeof(Engine);
+	}
+
+	bool
+	map(int fd, std::size_t bytes)
+	{
+		void* p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (p == MAP_FAILED)
+		{
+			return false;
+		}
+		data_ = static_cast<unsigned char*>(p);
+		bytes_ = bytes;
+		return true;
+	}
+
+	Engine*
+	slot(std::size_t i) const
+	{
+		return reinterpret_cast<Engine*>(data_ + header_size + i * sizeof(Engine));
+	}
+
+	unsigned char* data_ = nullptr;
+	std::size_t bytes_ = 0;
+	std::size_t count_ = 0;
+};
+
+}
+
+#endif /* guard_utils_isaac_file_bank_h */
@@ -0,0 +1,167 @@
+/*
+	ISAAC engines that fork in constant time.
+
+	Copies of a forkable engine share one engine state, copy-on-write. Each copy reads
+	the shared block of results through its own count, and copies the state only when
+	it needs the next block. A branch that draws fewer values than remain in the block
+	therefore never copies the state at all, which suits searches and simulations that
+	fork the generator at every node.
+*/
+
+#ifndef guard_utils_isaac_fork_h
+#define guard_utils_isaac_fork_h
+
+#include "isaac.h"
+#include <atomic>
+#include <memory>
+
+namespace utils
+{
+
+/************************************************************
+forkable_isaac<Engine> produces the sequence of the Engine it
+was constructed from. Copying it, or calling fork(), gives an
+independent engine that continues the same sequence, at the
+cost of a shared_ptr copy. The shared state is never modified
+while another copy refers to it. Copies may be used by
+different threads, but, as with other engines, a single copy
+may not be used by two threads at once.
+*************************************************************/
+
+template<class Engine>
+class forkable_isaac
+{
+public:
+	using engine_type = Engine;
+
+	using result_type = typename Engine::result_type;
+
+	static_assert(_isaac_new_aligns<Engine>::value, "before C++17, new doesn't align engines with isaac_aligned_storage");
+
+	static constexpr result_type min()
+	{
+		return Engine::min();
+	}
+	static constexpr result_type max()
+	{
+		return Engine::max();
+	}
+
+	explicit forkable_isaac(result_type s = 0)
+	:
+	forkable_isaac(Engine(s))
+	{}
+
+	/*
+		Continues the sequence of e. A word that fill_bytes() of e had only
+		partly used is dropped.
+	*/
+	explicit forkable_isaac(const Engine& e)
+	:
+	state_(std::make_shared<Engine>(e)),
+	count_(e.peek().size)
+	{}
+
+	forkable_isaac
+	fork() const
+	{
+		return *this;
+	}
+
+	inline result_type
+	operator()()
+	{
+		if (count_ == 0)
+		{
+			result_type r = own()();
+			count_ = state_->peek().size;
+			return r;
+		}
+		return state_->peek().data[--count_];
+	}
+
+	inline void
+	discard(unsigned long long z)
+	{
+		if (z <= count_)
+		{
+			count_ -= z;
+			return;
+		}
+		own().discard(z);
+		count_ = state_->peek().size;
+	}
+
+	/*
+		The number of values consumed since the engine was seeded.
+	*/
+	std::uint64_t
+	position() const
+	{
+		return state_->position() + state_->peek().size - count_;
+	}
+
+	/*
+		Returns a standalone engine in the same state.
+	*/
+	Engine
+	engine() const
+	{
+		Engine e(*state_);
+		e.discard(state_->peek().size - count_);
+		return e;
+	}
+
+	/*
+		True if this copy has the state to itself, so its next block will be
+		generated without copying the state first.
+	*/
+	bool
+	is_unique() const
+	{
+		return state_.use_count() == 1;
+	}
+
+	friend bool
+	operator==(const forkable_isaac& x, const forkable_isaac& y)
+	{
+		return x.state_ == y.state_ ? x.count_ == y.count_ : x.engine() == y.engine();
+	}
+
+	friend bool
+	operator!=(const forkable_isaac& x, const forkable_isaac& y)
+	{
+		return !(x == y);
+	}
+
+private:
+
+	/*
+		Returns the engine for modification, first copying the shared state if
+		other copies refer to it, and advancing it past the values this copy has
+		consumed. use_count() is a relaxed load, so once it shows this copy to
+		be the only one, the fence orders the writes below after the reads
+		other copies made through peek() before they released the state.
+	*/
+	Engine&
+	own()
+	{
+		if (state_.use_count() != 1)
+		{
+			state_ = std::make_shared<Engine>(*state_);
+		}
+		else
+		{
+			std::atomic_thread_fence(std::memory_order_acquire);
+		}
+		state_->discard(state_->peek().size - count_);
+		return *state_;
+	}
+
+	std::shared_ptr<Engine> state_;
+	std::size_t count_;	/* values left in the shared block for this copy */
+};
+
+}
+
+#endif /* guard_utils_isaac_fork_h */
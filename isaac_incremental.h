@@ -0,0 +1,154 @@
+/*
+	ISAAC engines that spread the generation of each block over the calls that
+	consume the previous one.
+
+	An engine generates a whole block of results in one call, every 2^Alpha calls, and
+	that call is several hundred times slower than the others. An incremental engine
+	generates the next block into a second buffer a few steps per call, so every call
+	does about the same, bounded, amount of work, and reaching the end of a block only
+	swaps the buffers. Unlike isaac_async.h, no other thread is involved, which suits
+	real-time threads that may neither stall nor hand off work. The sequence is that of
+	the synchronous engine.
+*/
+
+#ifndef guard_utils_isaac_incremental_h
+#define guard_utils_isaac_incremental_h
+
+#include "isaac.h"
+
+namespace utils
+{
+
+/************************************************************
+isaac_incremental<Engine, Steps> takes Steps steps of the
+next block on each call, until it is complete. A block takes
+2^Alpha steps and lasts 2^Alpha calls, so with Steps of 1 it
+is always complete when the current one runs out; a larger
+Steps finishes it early, and leaves the remaining calls of
+the block with no steps to take. Only discard(), and the
+first block of an engine constructed part way through a
+block, may take more steps at once. The engine's state is
+between blocks while one is being generated, so, unlike
+other engines, isaac_incremental can't be compared, or
+written to a stream; it can be copied.
+*************************************************************/
+
+template<class Engine, std::size_t Steps = 1>
+class isaac_incremental
+{
+public:
+	using engine_type = Engine;
+
+	using result_type = typename Engine::result_type;
+
+	static_assert(Steps >= 1, "each call must take at least one step");
+
+	static constexpr result_type min()
+	{
+		return Engine::min();
+	}
+	static constexpr result_type max()
+	{
+		return Engine::max();
+	}
+
+	explicit isaac_incremental(result_type s = 0)
+	:
+	isaac_incremental(Engine(s))
+	{}
+
+	/*
+		Continues the sequence of e. A word that fill_bytes() of e had only
+		partly used is dropped.
+	*/
+	explicit isaac_incremental(const Engine& e)
+	:
+	engine_(e)
+	{
+		typename Engine::block_view block = e.peek();
+		std::copy(block.begin(), block.end(), front());
+		count_ = block.size;
+		start_block();
+	}
+
+	inline result_type
+	operator()()
+	{
+		if (step_ < state_size)
+		{
+			std::size_t last = step_ + Steps < state_size ? step_ + Steps : state_size;
+			engine_.do_isaac_steps(back(), step_, last);
+			step_ = last;
+		}
+		if (count_ == 0)
+		{
+			next_block();
+		}
+		return front()[--count_];
+	}
+
+	inline void
+	discard(unsigned long long z)
+	{
+		while (z > count_)
+		{
+			z -= count_;
+			count_ = 0;
+			next_block();
+		}
+		count_ -= static_cast<std::size_t>(z);
+	}
+
+private:
+
+	static constexpr std::size_t state_size = std::size_t(1) << Engine::alpha;
+
+	result_type*
+	front()
+	{
+		return blocks_[current_];
+	}
+
+	result_type*
+	back()
+	{
+		return blocks_[current_ ^ 1];
+	}
+
+	/*
+		Begins generating the next block into the back buffer, as do_isaac()
+		begins a block.
+	*/
+	void
+	start_block()
+	{
+		engine_.b_ += ++engine_.c_;
+		step_ = 0;
+	}
+
+	/*
+		Finishes the back block, if it isn't finished yet, and swaps it to the
+		front.
+	*/
+	void
+	next_block()
+	{
+		if (step_ < state_size)
+		{
+			engine_.do_isaac_steps(back(), step_, state_size);
+		}
+		current_ ^= 1;
+		count_ = state_size;
+		start_block();
+	}
+
+	Engine engine_;
+	std::size_t current_ = 0;	/* the index of the front buffer */
+	std::size_t count_;			/* results left in the front buffer */
+	std::size_t step_;			/* the next step of the back buffer */
+	result_type blocks_[2][state_size];
+};
+
+}
+
+#endif /* guard_utils_isaac_incremental_h */
@@ -0,0 +1,1172 @@
+/*
+	Multi-lane ISAAC engines.
+
+	These engines run several independently seeded ISAAC streams side by side, with
+	their state interleaved in a structure-of-arrays layout, so that one pass of the
+	generator steps every stream at once. Each lane produces exactly the sequence of
+	the scalar engine (isaac or isaac64, see isaac.h) seeded the same way.
+*/
+
+#ifndef guard_utils_isaac_lanes_h
+#define guard_utils_isaac_lanes_h
+
+#include "isaac.h"
+#include <atomic>
+
+/*
+	The SIMD kernels are compiled for their instruction sets with target attributes
+	rather than command line options, so a single binary carries all of them and
+	picks one at run time.
+*/
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define UTILS_ISAAC_X86_KERNELS
+#define UTILS_ISAAC_TARGET_AVX2 __attribute__((target("avx2")))
+#define UTILS_ISAAC_TARGET_AVX512 __attribute__((target("avx512f")))
+#include <immintrin.h>
+#endif
+
+/*
+	GCC before 13 reports the self-initialized placeholders inside its own
+	AVX-512 intrinsics as uninitialized once they are inlined (GCC bug 105593).
+*/
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 13
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+namespace utils
+{
+
+/*
+	Instruction sets used by the multi-lane kernels, in increasing order.
+*/
+enum class isaac_isa
+{
+	scalar,
+	avx2,
+	avx512
+};
+
+/*
+	Returns the best instruction set supported by the CPU, as reported by cpuid.
+*/
+inline isaac_isa
+detect_isaac_isa()
+{
+#if defined(UTILS_ISAAC_X86_KERNELS)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+	{
+		return isaac_isa::avx512;
+	}
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return isaac_isa::avx2;
+	}
+#endif
+	return isaac_isa::scalar;
+}
+
+inline std::atomic<isaac_isa>&
+_isaac_isa_selection()
+{
+	static std::atomic<isaac_isa> selection(detect_isaac_isa());
+	return selection;
+}
+
+/*
+	The instruction set the multi-lane engines currently use. It is detected
+	once, on first use, unless overridden by force_isaac_isa().
+*/
+inline isaac_isa
+active_isaac_isa()
+{
+	return _isaac_isa_selection().load(std::memory_order_relaxed);
+}
+
+/*
+	Makes the multi-lane engines use the given instruction set, for example to
+	benchmark each kernel on the same machine. Returns false, leaving the selection
+	unchanged, if the CPU doesn't support it.
+*/
+inline bool
+force_isaac_isa(isaac_isa isa)
+{
+	if (isa > detect_isaac_isa())
+	{
+		return false;
+	}
+	_isaac_isa_selection().store(isa, std::memory_order_relaxed);
+	return true;
+}
+
+/************************************************************
+_isaac_lanes contains code common to isaac_lanes and
+isaac64_lanes. Element i of lane l is stored at index
+i * Lanes + l of result_ and memory_, so each row of the
+state holds one word from every lane, and a row can be
+processed as a single SIMD vector.
+Applications should not specialize or instantiate this
+template directly.
+*************************************************************/
+
+template<class Derived, std::size_t Alpha, class T, std::size_t Lanes>
+class _isaac_lanes
+{
+public:
+	using result_type = T;
+
+	static constexpr std::size_t lanes = Lanes;
+
+protected:
+	static constexpr std::size_t state_size = 1 << Alpha;
+
+	static constexpr std::size_t block_size = state_size * Lanes;
+
+	static constexpr int
+	_log2(std::size_t n)
+	{
+		return n <= 1 ? 0 : 1 + _log2(n / 2);
+	}
+
+	/* log2(Lanes), used to scale row indices when Lanes is a power of two */
+	static constexpr int lane_bits = _log2(Lanes);
+
+	explicit _isaac_lanes(const std::array<result_type, Lanes>& seeds)
+	{
+		seed(seeds);
+	}
+
+	_isaac_lanes(std::random_device& dev)
+	{
+		seed(dev);
+	}
+
+	_isaac_lanes(const result_type* seeds, std::size_t n)
+	{
+		seed(seeds, n);
+	}
+
+public:
+
+	static constexpr result_type min()
+	{
+		return std::numeric_limits<result_type>::min();
+	}
+	static constexpr result_type max()
+	{
+		return std::numeric_limits<result_type>::max();
+	}
+
+	/*
+		Lane l is seeded as the scalar engine constructed with seeds[l].
+	*/
+	void
+	seed(const std::array<result_type, Lanes>& seeds)
+	{
+		seed(seeds.data(), 1);
+	}
+
+	/*
+		Lane l is seeded with the n words at seeds + l * n, as the scalar engine
+		seeded with that range (so they are repeated to fill the state if n is
+		less than its size); n must be at least 1.
+	*/
+	void
+	seed(const result_type* seeds, std::size_t n)
+	{
+		for (std::size_t l = 0; l < Lanes; ++l)
+		{
+			const result_type* words = seeds + l * n;
+			for (std::size_t i = 0, j = 0; i < state_size; ++i)
+			{
+				result_[i * Lanes + l] = words[j];
+				j = (j + 1 == n) ? 0 : j + 1;
+			}
+		}
+		init();
+	}
+
+	void
+	seed(std::random_device& dev)
+	{
+		for (std::size_t l = 0; l < Lanes; ++l)
+		{
+			load_lane(l, typename Derived::engine_type(dev));
+		}
+		count_ = block_size;
+	}
+
+	/*
+		The combined sequence takes one value from each lane in turn, starting
+		with the highest lane. Taking every Lanes-th value, starting at offset
+		Lanes - 1 - l, gives the sequence of lane l.
+	*/
+	inline result_type
+	operator()()
+	{
+		return (!count_--) ? (do_isaac(), count_ = block_size - 1, result_[count_]) : result_[count_];
+	}
+
+	/*
+		Skips z values. Blocks that would be consumed entirely are generated
+		but never read, and the remainder is skipped by adjusting count_.
+	*/
+	inline void
+	discard(unsigned long long z)
+	{
+		if (z <= count_)
+		{
+			count_ -= z;
+			return;
+		}
+		z -= count_;
+		count_ = 0;
+		for (; z >= block_size; z -= block_size)
+		{
+			do_isaac();
+		}
+		if (z > 0)
+		{
+			do_isaac();
+			count_ = block_size - z;
+		}
+	}
+
+	friend bool
+	operator==(const _isaac_lanes& x, const _isaac_lanes& y)
+	{
+		if (x.count_ != y.count_)
+		{
+			return false;
+		}
+		for (std::size_t l = 0; l < Lanes; ++l)
+		{
+			if (x.a_[l] != y.a_[l] || x.b_[l] != y.b_[l] || x.c_[l] != y.c_[l])
+			{
+				return false;
+			}
+		}
+		for (std::size_t i = 0; i < block_size; ++i)
+		{
+			if ((i < x.count_ && x.result_[i] != y.result_[i]) || x.memory_[i] != y.memory_[i])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	friend bool
+	operator!=(const _isaac_lanes& x, const _isaac_lanes& y)
+	{
+		return !(x == y);
+	}
+
+protected:
+
+	/*
+		The scalar engine's init(), run for every lane at once, with the seed
+		in result_. Rows i to i + 7 of the state hold the eight words that one
+		mix() step combines, for every lane, in the layout of v.
+	*/
+	void
+	init()
+	{
+		const result_type* scrambled = Derived::engine_type::golden_mix();
+		result_type v[8][Lanes];
+		for (std::size_t k = 0; k < 8; ++k)
+		{
+			for (std::size_t l = 0; l < Lanes; ++l)
+			{
+				v[k][l] = scrambled[k];
+			}
+		}
+		for (std::size_t l = 0; l < Lanes; ++l)
+		{
+			a_[l] = 0;
+			b_[l] = 0;
+			c_[l] = 0;
+		}
+		init_pass(v, result_);
+		init_pass(v, memory_);
+		do_isaac();
+		count_ = block_size;
+	}
+
+
+	/*
+		One pass of init(): mixes each group of eight rows of src into v in
+		turn, storing the results in memory_.
+	*/
+	void
+	init_pass(result_type (&v)[8][Lanes], const result_type* src)
+	{
+		for (std::size_t i = 0; i < state_size; i += 8)
+		{
+			for (std::size_t k = 0; k < 8; ++k)
+			{
+				for (std::size_t l = 0; l < Lanes; ++l)
+				{
+					v[k][l] += src[(i + k) * Lanes + l];
+				}
+			}
+			Derived::_mix(v);
+			for (std::size_t k = 0; k < 8; ++k)
+			{
+				for (std::size_t l = 0; l < Lanes; ++l)
+				{
+					memory_[(i + k) * Lanes + l] = v[k][l];
+				}
+			}
+		}
+	}
+
+	/*
+		Copies the state of a freshly seeded scalar engine into lane l.
+	*/
+	template<class Engine>
+	void
+	load_lane(std::size_t l, const Engine& e)
+	{
+		for (std::size_t i = 0; i < state_size; ++i)
+		{
+			result_[i * Lanes + l] = e.result_[i];
+			memory_[i * Lanes + l] = e.memory_[i];
+		}
+		a_[l] = e.a_;
+		b_[l] = e.b_;
+		c_[l] = e.c_;
+	}
+
+	/*
+		Copies the state of lane l into a scalar engine, with count values left
+		in the current block.
+	*/
+	template<class Engine>
+	void
+	store_lane(std::size_t l, Engine& e, std::size_t count) const
+	{
+		for (std::size_t i = 0; i < state_size; ++i)
+		{
+			e.result_[i] = result_[i * Lanes + l];
+			e.memory_[i] = memory_[i * Lanes + l];
+		}
+		e.a_ = a_[l];
+		e.b_ = b_[l];
+		e.c_ = c_[l];
+		e.count_ = count;
+		e.byte_count_ = count * sizeof(result_type);
+	}
+
+	inline void
+	do_isaac()
+	{
+		static_cast<Derived*>(this)->_do_isaac();
+	}
+
+	/*
+		Generates the next block of lane l only, leaving the other lanes as they are.
+	*/
+	inline void
+	do_isaac_lane(std::size_t l)
+	{
+		static_cast<Derived*>(this)->_do_isaac_lane(l);
+	}
+
+	template<class> friend class isaac_lanes_bank;
+
+	result_type result_[block_size];
+	result_type memory_[block_size];
+	result_type a_[Lanes];
+	result_type b_[Lanes];
+	result_type c_[Lanes];
+	std::size_t count_;
+};
+
+
+/*
+	When Simd is false, the portable kernel is always used, whatever the CPU supports.
+*/
+template<std::size_t Alpha = 8, std::size_t Lanes = 8, bool Simd = true>
+class isaac_lanes : public _isaac_lanes<isaac_lanes<Alpha, Lanes, Simd>, Alpha, std::uint32_t, Lanes>
+{
+public:
+
+	using base = _isaac_lanes<isaac_lanes, Alpha, std::uint32_t, Lanes>;
+
+	friend class _isaac_lanes<isaac_lanes, Alpha, std::uint32_t, Lanes>;
+
+	using result_type = std::uint32_t;
+
+	using engine_type = isaac<Alpha>;
+
+	explicit isaac_lanes(const std::array<result_type, Lanes>& seeds)
+	:
+	base::_isaac_lanes(seeds)
+	{}
+
+	isaac_lanes(std::random_device& dev)
+	:
+	base::_isaac_lanes(dev)
+	{}
+
+	isaac_lanes(const result_type* seeds, std::size_t n)
+	:
+	base::_isaac_lanes(seeds, n)
+	{}
+
+private:
+
+	/*
+		The scalar engine's mix(), for every lane.
+	*/
+	static inline void
+	_mix(result_type (&v)[8][Lanes])
+	{
+		for (std::size_t l = 0; l < Lanes; ++l)
+		{
+			result_type a = v[0][l], b = v[1][l], c = v[2][l], d = v[3][l];
+			result_type e = v[4][l], f = v[5][l], g = v[6][l], h = v[7][l];
+			a ^= b << 11; d += a; b += c;
+			b ^= c >> 2;  e += b; c += d;
+			c ^= d << 8;  f += c; d += e;
+			d ^= e >> 16; g += d; e += f;
+			e ^= f << 10; h += e; f += g;
+			f ^= g >> 4;  a += f; g += h;
+			g ^= h << 8;  b += g; h += a;
+			h ^= a >> 9;  c += h; a += b;
+			v[0][l] = a; v[1][l] = b; v[2][l] = c; v[3][l] = d;
+			v[4][l] = e; v[5][l] = f; v[6][l] = g; v[7][l] = h;
+		}
+	}
+
+	template<int Step>
+	static inline result_type
+	_rngmix(result_type a)
+	{
+		return Step == 0 ? a << 13 : Step == 1 ? a >> 6 : Step == 2 ? a << 2 : a >> 16;
+	}
+
+	static inline result_type
+	ind(const result_type* mm, result_type x, std::size_t l)
+	{
+		return mm[((x >> 2) & (base::state_size - 1)) * Lanes + l];
+	}
+
+	/*
+		Performs one rngstep for every lane. The lanes are independent of each
+		other, so their dependency chains overlap.
+	*/
+	template<int Step>
+	inline void
+	rngstep(result_type* a, result_type* b, result_type* mm, result_type*& m, result_type*& m2, result_type*& r)
+	{
+		for (std::size_t l = 0; l < Lanes; ++l)
+		{
+			result_type x = m[l];
+			result_type y;
+			a[l] = (a[l] ^ _rngmix<Step>(a[l])) + m2[l];
+			m[l] = y = ind(mm, x, l) + a[l] + b[l];
+			r[l] = b[l] = ind(mm, y >> Alpha, l) + x;
+		}
+		m += Lanes;
+		m2 += Lanes;
+		r += Lanes;
+	}
+
+	void
+	_do_isaac_generic()
+	{
+		result_type a[Lanes];
+		result_type b[Lanes];
+		result_type * m;
+		result_type * mm;
+		result_type * m2;
+		result_type * r;
+		result_type * mend;
+
+		for (std::size_t l = 0; l < Lanes; ++l)
+		{
+			a[l] = base::a_[l];
+			b[l] = base::b_[l] + (++base::c_[l]);
+		}
+		mm = base::memory_;
+		r = base::result_;
+		for (m = mm, mend = m2 = m + (base::block_size / 2); m < mend; )
+		{
+			rngstep<0>(a, b, mm, m, m2, r);
+			rngstep<1>(a, b, mm, m, m2, r);
+			rngstep<2>(a, b, mm, m, m2, r);
+			rngstep<3>(a, b, mm, m, m2, r);
+		}
+		for (m2 = mm; m2 < mend; )
+		{
+			rngstep<0>(a, b, mm, m, m2, r);
+			rngstep<1>(a, b, mm, m, m2, r);
+			rngstep<2>(a, b, mm, m, m2, r);
+			rngstep<3>(a, b, mm, m, m2, r);
+		}
+		for (std::size_t l = 0; l < Lanes; ++l)
+		{
+			base::a_[l] = a[l];
+			base::b_[l] = b[l];
+		}
+	}
+
+	/*
+		Performs one rngstep for lane l alone, as the scalar engine would.
+	*/
+	template<int Step>
+	inline void
+	rngstep(result_type& a, result_type& b, const result_type* mm, result_type*& m, result_type*& m2, result_type*& r, std::size_t l)
+	{
+		result_type x = *m;
+		result_type y;
+		a = (a ^ _rngmix<Step>(a)) + *m2;
+		*m = y = ind(mm, x, l) + a + b;
+		*r = b = ind(mm, y >> Alpha, l) + x;
+		m += Lanes;
+		m2 += Lanes;
+		r += Lanes;
+	}
+
+	/*
+		Steps lane l through the whole block. isaac_lanes_bank uses this to
+		refill an engine that runs out ahead of the others in its group.
+	*/
+	void
+	_do_isaac_lane(std::size_t l)
+	{
+		result_type a;
+		result_type b;
+		result_type * m;
+		result_type * mm;
+		result_type * m2;
+		result_type * r;
+		result_type * mend;
+
+		a = base::a_[l];
+		b = base::b_[l] + (++base::c_[l]);
+		mm = base::memory_;
+		r = base::result_ + l;
+		for (m = mm + l, mend = m2 = m + (base::block_size / 2); m < mend; )
+		{
+			rngstep<0>(a, b, mm, m, m2, r, l);
+			rngstep<1>(a, b, mm, m, m2, r, l);
+			rngstep<2>(a, b, mm, m, m2, r, l);
+			rngstep<3>(a, b, mm, m, m2, r, l);
+		}
+		for (m2 = mm + l; m2 < mend; )
+		{
+			rngstep<0>(a, b, mm, m, m2, r, l);
+			rngstep<1>(a, b, mm, m, m2, r, l);
+			rngstep<2>(a, b, mm, m, m2, r, l);
+			rngstep<3>(a, b, mm, m, m2, r, l);
+		}
+		base::a_[l] = a;
+		base::b_[l] = b;
+	}
+
+#if defined(UTILS_ISAAC_X86_KERNELS)
+
+	/*
+		The SIMD kernels process lanes in groups of one register, and scale
+		row indices by shifting, so they need a power-of-two number of lanes
+		that is a multiple of the register width.
+	*/
+	static constexpr bool avx2_lanes = Simd && (Lanes % 8 == 0) && ((Lanes & (Lanes - 1)) == 0);
+
+	static constexpr bool avx512_lanes = Simd && (Lanes % 16 == 0) && ((Lanes & (Lanes - 1)) == 0);
+
+	template<int Step>
+	UTILS_ISAAC_TARGET_AVX2 static inline __m256i
+	_rngmix(__m256i a)
+	{
+		switch (Step)
+		{
+			case 0: return _mm256_slli_epi32(a, 13);
+			case 1: return _mm256_srli_epi32(a, 6);
+			case 2: return _mm256_slli_epi32(a, 2);
+			default: return _mm256_srli_epi32(a, 16);
+		}
+	}
+
+	/*
+		Gather indices for ind(), for one group of lanes; bits 2 and up of v
+		select the row.
+	*/
+	UTILS_ISAAC_TARGET_AVX2 static inline __m256i
+	ind_index(__m256i v, __m256i lane)
+	{
+		const __m256i mask = _mm256_set1_epi32(base::state_size - 1);
+		__m256i word = _mm256_and_si256(_mm256_srli_epi32(v, 2), mask);
+		return _mm256_add_epi32(_mm256_slli_epi32(word, base::lane_bits), lane);
+	}
+
+	template<int Step>
+	UTILS_ISAAC_TARGET_AVX2 inline void
+	rngstep(__m256i& a, __m256i& b, const __m256i lane, result_type* mm,
+			result_type*& m, result_type*& m2, result_type*& r)
+	{
+		const int* base_ptr = reinterpret_cast<const int*>(mm);
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(m));
+		a = _mm256_add_epi32(_mm256_xor_si256(a, _rngmix<Step>(a)),
+							 _mm256_loadu_si256(reinterpret_cast<const __m256i*>(m2)));
+		__m256i y = _mm256_add_epi32(_mm256_add_epi32(
+					_mm256_i32gather_epi32(base_ptr, ind_index(x, lane), 4), a), b);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(m), y);
+		b = _mm256_add_epi32(_mm256_i32gather_epi32(base_ptr, ind_index(_mm256_srli_epi32(y, Alpha), lane), 4), x);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(r), b);
+		m += Lanes;
+		m2 += Lanes;
+		r += Lanes;
+	}
+
+	/*
+		Steps each group of 8 lanes through the whole block with AVX2, using
+		gathers for the ind() lookups.
+	*/
+	UTILS_ISAAC_TARGET_AVX2 void
+	_do_isaac_avx2()
+	{
+		const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		for (std::size_t g = 0; g < Lanes; g += 8)
+		{
+			result_type * m;
+			result_type * mm;
+			result_type * m2;
+			result_type * r;
+			result_type * mend;
+
+			__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(base::a_ + g));
+			__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(base::b_ + g));
+			__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(base::c_ + g));
+			c = _mm256_add_epi32(c, _mm256_set1_epi32(1));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(base::c_ + g), c);
+			b = _mm256_add_epi32(b, c);
+
+			mm = base::memory_ + g;
+			r = base::result_ + g;
+			for (m = mm, mend = m2 = m + (base::block_size / 2); m < mend; )
+			{
+				rngstep<0>(a, b, lane, mm, m, m2, r);
+				rngstep<1>(a, b, lane, mm, m, m2, r);
+				rngstep<2>(a, b, lane, mm, m, m2, r);
+				rngstep<3>(a, b, lane, mm, m, m2, r);
+			}
+			for (m2 = mm; m2 < mend; )
+			{
+				rngstep<0>(a, b, lane, mm, m, m2, r);
+				rngstep<1>(a, b, lane, mm, m, m2, r);
+				rngstep<2>(a, b, lane, mm, m, m2, r);
+				rngstep<3>(a, b, lane, mm, m, m2, r);
+			}
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(base::a_ + g), a);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(base::b_ + g), b);
+		}
+	}
+
+	template<int Step>
+	UTILS_ISAAC_TARGET_AVX512 static inline __m512i
+	_rngmix(__m512i a)
+	{
+		switch (Step)
+		{
+			case 0: return _mm512_slli_epi32(a, 13);
+			case 1: return _mm512_srli_epi32(a, 6);
+			case 2: return _mm512_slli_epi32(a, 2);
+			default: return _mm512_srli_epi32(a, 16);
+		}
+	}
+
+	UTILS_ISAAC_TARGET_AVX512 static inline __m512i
+	ind_index(__m512i v, __m512i lane)
+	{
+		const __m512i mask = _mm512_set1_epi32(base::state_size - 1);
+		__m512i word = _mm512_and_si512(_mm512_srli_epi32(v, 2), mask);
+		return _mm512_add_epi32(_mm512_slli_epi32(word, base::lane_bits), lane);
+	}
+
+	template<int Step>
+	UTILS_ISAAC_TARGET_AVX512 inline void
+	rngstep(__m512i& a, __m512i& b, const __m512i lane, result_type* mm,
+			result_type*& m, result_type*& m2, result_type*& r)
+	{
+		__m512i x = _mm512_loadu_si512(m);
+		a = _mm512_add_epi32(_mm512_xor_si512(a, _rngmix<Step>(a)), _mm512_loadu_si512(m2));
+		__m512i y = _mm512_add_epi32(_mm512_add_epi32(
+					_mm512_i32gather_epi32(ind_index(x, lane), mm, 4), a), b);
+		_mm512_storeu_si512(m, y);
+		b = _mm512_add_epi32(_mm512_i32gather_epi32(ind_index(_mm512_srli_epi32(y, Alpha), lane), mm, 4), x);
+		_mm512_storeu_si512(r, b);
+		m += Lanes;
+		m2 += Lanes;
+		r += Lanes;
+	}
+
+	/*
+		As _do_isaac_avx2(), with groups of 16 lanes.
+	*/
+	UTILS_ISAAC_TARGET_AVX512 void
+	_do_isaac_avx512()
+	{
+		const __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+		for (std::size_t g = 0; g < Lanes; g += 16)
+		{
+			result_type * m;
+			result_type * mm;
+			result_type * m2;
+			result_type * r;
+			result_type * mend;
+
+			__m512i a = _mm512_loadu_si512(base::a_ + g);
+			__m512i b = _mm512_loadu_si512(base::b_ + g);
+			__m512i c = _mm512_loadu_si512(base::c_ + g);
+			c = _mm512_add_epi32(c, _mm512_set1_epi32(1));
+			_mm512_storeu_si512(base::c_ + g, c);
+			b = _mm512_add_epi32(b, c);
+
+			mm = base::memory_ + g;
+			r = base::result_ + g;
+			for (m = mm, mend = m2 = m + (base::block_size / 2); m < mend; )
+			{
+				rngstep<0>(a, b, lane, mm, m, m2, r);
+				rngstep<1>(a, b, lane, mm, m, m2, r);
+				rngstep<2>(a, b, lane, mm, m, m2, r);
+				rngstep<3>(a, b, lane, mm, m, m2, r);
+			}
+			for (m2 = mm; m2 < mend; )
+			{
+				rngstep<0>(a, b, lane, mm, m, m2, r);
+				rngstep<1>(a, b, lane, mm, m, m2, r);
+				rngstep<2>(a, b, lane, mm, m, m2, r);
+				rngstep<3>(a, b, lane, mm, m, m2, r);
+			}
+			_mm512_storeu_si512(base::a_ + g, a);
+			_mm512_storeu_si512(base::b_ + g, b);
+		}
+	}
+
+#endif
+
+	inline void
+	_do_isaac()
+	{
+#if defined(UTILS_ISAAC_X86_KERNELS)
+		isaac_isa isa = active_isaac_isa();
+		if (avx512_lanes && isa == isaac_isa::avx512)
+		{
+			_do_isaac_avx512();
+			return;
+		}
+		if (avx2_lanes && isa >= isaac_isa::avx2)
+		{
+			_do_isaac_avx2();
+			return;
+		}
+#endif
+		_do_isaac_generic();
+	}
+};
+
+
+template<std::size_t Alpha = 8, std::size_t Lanes = 4, bool Simd = true>
+class isaac64_lanes : public _isaac_lanes<isaac64_lanes<Alpha, Lanes, Simd>, Alpha, std::uint64_t, Lanes>
+{
+public:
+
+	using result_type = std::uint64_t;
+
+	using base = _isaac_lanes<isaac64_lanes, Alpha, std::uint64_t, Lanes>;
+
+	friend class _isaac_lanes<isaac64_lanes, Alpha, std::uint64_t, Lanes>;
+
+	using engine_type = isaac64<Alpha>;
+
+	explicit isaac64_lanes(const std::array<result_type, Lanes>& seeds)
+	:
+	base::_isaac_lanes(seeds)
+	{}
+
+	isaac64_lanes(std::random_device& dev)
+	:
+	base::_isaac_lanes(dev)
+	{}
+
+	isaac64_lanes(const result_type* seeds, std::size_t n)
+	:
+	base::_isaac_lanes(seeds, n)
+	{}
+
+private:
+
+	static inline void
+	_mix(result_type (&v)[8][Lanes])
+	{
+		for (std::size_t l = 0; l < Lanes; ++l)
+		{
+			result_type a = v[0][l], b = v[1][l], c = v[2][l], d = v[3][l];
+			result_type e = v[4][l], f = v[5][l], g = v[6][l], h = v[7][l];
+			a -= e; f ^= h >> 9;  h += a;
+			b -= f; g ^= a << 9;  a += b;
+			c -= g; h ^= b >> 23; b += c;
+			d -= h; a ^= c << 15; c += d;
+			e -= a; b ^= d >> 14; d += e;
+			f -= b; c ^= e << 20; e += f;
+			g -= c; d ^= f >> 17; f += g;
+			h -= d; e ^= g << 14; g += h;
+			v[0][l] = a; v[1][l] = b; v[2][l] = c; v[3][l] = d;
+			v[4][l] = e; v[5][l] = f; v[6][l] = g; v[7][l] = h;
+		}
+	}
+
+	template<int Step>
+	static inline result_type
+	_rngmix(result_type a)
+	{
+		return Step == 0 ? ~(a ^ (a << 21)) : Step == 1 ? a ^ (a >> 5) : Step == 2 ? a ^ (a << 12) : a ^ (a >> 33);
+	}
+
+	static inline result_type
+	ind(const result_type* mm, result_type x, std::size_t l)
+	{
+		return mm[((x >> 3) & (base::state_size - 1)) * Lanes + l];
+	}
+
+	template<int Step>
+	inline void
+	rngstep(result_type* a, result_type* b, result_type* mm, result_type*& m, result_type*& m2, result_type*& r)
+	{
+		for (std::size_t l = 0; l < Lanes; ++l)
+		{
+			result_type x = m[l];
+			result_type y;
+			a[l] = _rngmix<Step>(a[l]) + m2[l];
+			m[l] = y = ind(mm, x, l) + a[l] + b[l];
+			r[l] = b[l] = ind(mm, y >> Alpha, l) + x;
+		}
+		m += Lanes;
+		m2 += Lanes;
+		r += Lanes;
+	}
+
+	void
+	_do_isaac_generic()
+	{
+		result_type a[Lanes];
+		result_type b[Lanes];
+		result_type * m;
+		result_type * mm;
+		result_type * m2;
+		result_type * r;
+		result_type * mend;
+
+		for (std::size_t l = 0; l < Lanes; ++l)
+		{
+			a[l] = base::a_[l];
+			b[l] = base::b_[l] + (++base::c_[l]);
+		}
+		mm = base::memory_;
+		r = base::result_;
+		for (m = mm, mend = m2 = m + (base::block_size / 2); m < mend; )
+		{
+			rngstep<0>(a, b, mm, m, m2, r);
+			rngstep<1>(a, b, mm, m, m2, r);
+			rngstep<2>(a, b, mm, m, m2, r);
+			rngstep<3>(a, b, mm, m, m2, r);
+		}
+		for (m2 = mm; m2 < mend; )
+		{
+			rngstep<0>(a, b, mm, m, m2, r);
+			rngstep<1>(a, b, mm, m, m2, r);
+			rngstep<2>(a, b, mm, m, m2, r);
+			rngstep<3>(a, b, mm, m, m2, r);
+		}
+		for (std::size_t l = 0; l < Lanes; ++l)
+		{
+			base::a_[l] = a[l];
+			base::b_[l] = b[l];
+		}
+	}
+
+	/*
+		Performs one rngstep for lane l alone, as the scalar engine would.
+	*/
+	template<int Step>
+	inline void
+	rngstep(result_type& a, result_type& b, const result_type* mm, result_type*& m, result_type*& m2, result_type*& r, std::size_t l)
+	{
+		result_type x = *m;
+		result_type y;
+		a = _rngmix<Step>(a) + *m2;
+		*m = y = ind(mm, x, l) + a + b;
+		*r = b = ind(mm, y >> Alpha, l) + x;
+		m += Lanes;
+		m2 += Lanes;
+		r += Lanes;
+	}
+
+	/*
+		Steps lane l through the whole block. isaac_lanes_bank uses this to
+		refill an engine that runs out ahead of the others in its group.
+	*/
+	void
+	_do_isaac_lane(std::size_t l)
+	{
+		result_type a;
+		result_type b;
+		result_type * m;
+		result_type * mm;
+		result_type * m2;
+		result_type * r;
+		result_type * mend;
+
+		a = base::a_[l];
+		b = base::b_[l] + (++base::c_[l]);
+		mm = base::memory_;
+		r = base::result_ + l;
+		for (m = mm + l, mend = m2 = m + (base::block_size / 2); m < mend; )
+		{
+			rngstep<0>(a, b, mm, m, m2, r, l);
+			rngstep<1>(a, b, mm, m, m2, r, l);
+			rngstep<2>(a, b, mm, m, m2, r, l);
+			rngstep<3>(a, b, mm, m, m2, r, l);
+		}
+		for (m2 = mm + l; m2 < mend; )
+		{
+			rngstep<0>(a, b, mm, m, m2, r, l);
+			rngstep<1>(a, b, mm, m, m2, r, l);
+			rngstep<2>(a, b, mm, m, m2, r, l);
+			rngstep<3>(a, b, mm, m, m2, r, l);
+		}
+		base::a_[l] = a;
+		base::b_[l] = b;
+	}
+
+#if defined(UTILS_ISAAC_X86_KERNELS)
+
+	static constexpr bool avx2_lanes = Simd && (Lanes % 4 == 0) && ((Lanes & (Lanes - 1)) == 0);
+
+	static constexpr bool avx512_lanes = Simd && (Lanes % 8 == 0) && ((Lanes & (Lanes - 1)) == 0);
+
+	template<int Step>
+	UTILS_ISAAC_TARGET_AVX2 static inline __m256i
+	_rngmix(__m256i a)
+	{
+		switch (Step)
+		{
+			case 0: return _mm256_xor_si256(_mm256_xor_si256(a, _mm256_slli_epi64(a, 21)), _mm256_set1_epi64x(-1));
+			case 1: return _mm256_xor_si256(a, _mm256_srli_epi64(a, 5));
+			case 2: return _mm256_xor_si256(a, _mm256_slli_epi64(a, 12));
+			default: return _mm256_xor_si256(a, _mm256_srli_epi64(a, 33));
+		}
+	}
+
+	UTILS_ISAAC_TARGET_AVX2 static inline __m256i
+	ind_index(__m256i v, __m256i lane)
+	{
+		const __m256i mask = _mm256_set1_epi64x(base::state_size - 1);
+		__m256i word = _mm256_and_si256(_mm256_srli_epi64(v, 3), mask);
+		return _mm256_add_epi64(_mm256_slli_epi64(word, base::lane_bits), lane);
+	}
+
+	template<int Step>
+	UTILS_ISAAC_TARGET_AVX2 inline void
+	rngstep(__m256i& a, __m256i& b, const __m256i lane, result_type* mm,
+			result_type*& m, result_type*& m2, result_type*& r)
+	{
+		const long long* base_ptr = reinterpret_cast<const long long*>(mm);
+		__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(m));
+		a = _mm256_add_epi64(_rngmix<Step>(a), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(m2)));
+		__m256i y = _mm256_add_epi64(_mm256_add_epi64(
+					_mm256_i64gather_epi64(base_ptr, ind_index(x, lane), 8), a), b);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(m), y);
+		b = _mm256_add_epi64(_mm256_i64gather_epi64(base_ptr, ind_index(_mm256_srli_epi64(y, Alpha), lane), 8), x);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(r), b);
+		m += Lanes;
+		m2 += Lanes;
+		r += Lanes;
+	}
+
+	UTILS_ISAAC_TARGET_AVX2 void
+	_do_isaac_avx2()
+	{
+		const __m256i lane = _mm256_setr_epi64x(0, 1, 2, 3);
+		for (std::size_t g = 0; g < Lanes; g += 4)
+		{
+			result_type * m;
+			result_type * mm;
+			result_type * m2;
+			result_type * r;
+			result_type * mend;
+
+			__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(base::a_ + g));
+			__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(base::b_ + g));
+			__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(base::c_ + g));
+			c = _mm256_add_epi64(c, _mm256_set1_epi64x(1));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(base::c_ + g), c);
+			b = _mm256_add_epi64(b, c);
+
+			mm = base::memory_ + g;
+			r = base::result_ + g;
+			for (m = mm, mend = m2 = m + (base::block_size / 2); m < mend; )
+			{
+				rngstep<0>(a, b, lane, mm, m, m2, r);
+				rngstep<1>(a, b, lane, mm, m, m2, r);
+				rngstep<2>(a, b, lane, mm, m, m2, r);
+				rngstep<3>(a, b, lane, mm, m, m2, r);
+			}
+			for (m2 = mm; m2 < mend; )
+			{
+				rngstep<0>(a, b, lane, mm, m, m2, r);
+				rngstep<1>(a, b, lane, mm, m, m2, r);
+				rngstep<2>(a, b, lane, mm, m, m2, r);
+				rngstep<3>(a, b, lane, mm, m, m2, r);
+			}
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(base::a_ + g), a);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(base::b_ + g), b);
+		}
+	}
+
+	template<int Step>
+	UTILS_ISAAC_TARGET_AVX512 static inline __m512i
+	_rngmix(__m512i a)
+	{
+		switch (Step)
+		{
+			case 0: return _mm512_xor_si512(_mm512_xor_si512(a, _mm512_slli_epi64(a, 21)), _mm512_set1_epi64(-1));
+			case 1: return _mm512_xor_si512(a, _mm512_srli_epi64(a, 5));
+			case 2: return _mm512_xor_si512(a, _mm512_slli_epi64(a, 12));
+			default: return _mm512_xor_si512(a, _mm512_srli_epi64(a, 33));
+		}
+	}
+
+	UTILS_ISAAC_TARGET_AVX512 static inline __m512i
+	ind_index(__m512i v, __m512i lane)
+	{
+		const __m512i mask = _mm512_set1_epi64(base::state_size - 1);
+		__m512i word = _mm512_and_si512(_mm512_srli_epi64(v, 3), mask);
+		return _mm512_add_epi64(_mm512_slli_epi64(word, base::lane_bits), lane);
+	}
+
+	template<int Step>
+	UTILS_ISAAC_TARGET_AVX512 inline void
+	rngstep(__m512i& a, __m512i& b, const __m512i lane, result_type* mm,
+			result_type*& m, result_type*& m2, result_type*& r)
+	{
+		__m512i x = _mm512_loadu_si512(m);
+		a = _mm512_add_epi64(_rngmix<Step>(a), _mm512_loadu_si512(m2));
+		__m512i y = _mm512_add_epi64(_mm512_add_epi64(
+					_mm512_i64gather_epi64(ind_index(x, lane), mm, 8), a), b);
+		_mm512_storeu_si512(m, y);
+		b = _mm512_add_epi64(_mm512_i64gather_epi64(ind_index(_mm512_srli_epi64(y, Alpha), lane), mm, 8), x);
+		_mm512_storeu_si512(r, b);
+		m += Lanes;
+		m2 += Lanes;
+		r += Lanes;
+	}
+
+	UTILS_ISAAC_TARGET_AVX512 void
+	_do_isaac_avx512()
+	{
+		const __m512i lane = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+		for (std::size_t g = 0; g < Lanes; g += 8)
+		{
+			result_type * m;
+			result_type * mm;
+			result_type * m2;
+			result_type * r;
+			result_type * mend;
+
+			__m512i a = _mm512_loadu_si512(base::a_ + g);
+			__m512i b = _mm512_loadu_si512(base::b_ + g);
+			__m512i c = _mm512_loadu_si512(base::c_ + g);
+			c = _mm512_add_epi64(c, _mm512_set1_epi64(1));
+			_mm512_storeu_si512(base::c_ + g, c);
+			b = _mm512_add_epi64(b, c);
+
+			mm = base::memory_ + g;
+			r = base::result_ + g;
+			for (m = mm, mend = m2 = m + (base::block_size / 2); m < mend; )
+			{
+				rngstep<0>(a, b, lane, mm, m, m2, r);
+				rngstep<1>(a, b, lane, mm, m, m2, r);
+				rngstep<2>(a, b, lane, mm, m, m2, r);
+				rngstep<3>(a, b, lane, mm, m, m2, r);
+			}
+			for (m2 = mm; m2 < mend; )
+			{
+				rngstep<0>(a, b, lane, mm, m, m2, r);
+				rngstep<1>(a, b, lane, mm, m, m2, r);
+				rngstep<2>(a, b, lane, mm, m, m2, r);
+				rngstep<3>(a, b, lane, mm, m, m2, r);
+			}
+			_mm512_storeu_si512(base::a_ + g, a);
+			_mm512_storeu_si512(base::b_ + g, b);
+		}
+	}
+
+#endif
+
+	inline void
+	_do_isaac()
+	{
+#if defined(UTILS_ISAAC_X86_KERNELS)
+		isaac_isa isa = active_isaac_isa();
+		if (avx512_lanes && isa == isaac_isa::avx512)
+		{
+			_do_isaac_avx512();
+			return;
+		}
+		if (avx2_lanes && isa >= isaac_isa::avx2)
+		{
+			_do_isaac_avx2();
+			return;
+		}
+#endif
+		_do_isaac_generic();
+	}
+};
+
+/*
+	8 lanes of isaac fill one 256-bit AVX2 register, as do 4 lanes of isaac64.
+	The x16 and x8 (64-bit) forms fill one 512-bit AVX-512 register, and run as
+	two AVX2 registers on CPUs without AVX-512.
+*/
+template<std::size_t Alpha = 8>
+using isaac_x8 = isaac_lanes<Alpha, 8>;
+
+template<std::size_t Alpha = 8>
+using isaac_x16 = isaac_lanes<Alpha, 16>;
+
+template<std::size_t Alpha = 8>
+using isaac64_x4 = isaac64_lanes<Alpha, 4>;
+
+template<std::size_t Alpha = 8>
+using isaac64_x8 = isaac64_lanes<Alpha, 8>;
+
+/*
+	Scalar instruction-level parallelism: 2 to 4 streams stepped in one loop with
+	ordinary integer instructions. While one stream waits on its ind() lookups,
+	the out-of-order core works on the others, which needs no SIMD support at all.
+	More ways than the integer registers can hold just spill.
+*/
+template<std::size_t Alpha = 8, std::size_t Ways = 2>
+using isaac_ilp = isaac_lanes<Alpha, Ways, false>;
+
+template<std::size_t Alpha = 8, std::size_t Ways = 2>
+using isaac64_ilp = isaac64_lanes<Alpha, Ways, false>;
+
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 13
+#pragma GCC diagnostic pop
+#endif
+
+#undef UTILS_ISAAC_X86_KERNELS
+#undef UTILS_ISAAC_TARGET_AVX2
+#undef UTILS_ISAAC_TARGET_AVX512
+
+#endif /* guard_utils_isaac_lanes_h */
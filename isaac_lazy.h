@@ -0,0 +1,194 @@
+/*
+	Lazily materialized ISAAC engines.
+
+	A lazy engine holds only its seed and the number of values consumed until it is
+	first used; then it constructs the engine it stands for, and advances it to that
+	position. It can later be demoted back to its seed and position, releasing the
+	engine's state. In a large population of engines of which few are used in a given
+	run, the unused ones cost a few words each, rather than a full state and an init().
+*/
+
+#ifndef guard_utils_isaac_lazy_h
+#define guard_utils_isaac_lazy_h
+
+#include "isaac.h"
+#include <memory>
+
+namespace utils
+{
+
+/************************************************************
+lazy_isaac<Engine> produces the sequence of Engine seeded
+with a single value. While dormant, it is the size of three
+pointers. Materializing an engine that has already consumed
+values discards them anew, which costs about as much as
+generating them did, so demote() suits engines that will be
+idle for a long time, or that were used only a little.
+*************************************************************/
+
+template<class Engine>
+class lazy_isaac
+{
+public:
+	using engine_type = Engine;
+
+	using result_type = typename Engine::result_type;
+
+	static_assert(_isaac_new_aligns<Engine>::value, "before C++17, new doesn't align engines with isaac_aligned_storage");
+
+	static constexpr result_type min()
+	{
+		return Engine::min();
+	}
+	static constexpr result_type max()
+	{
+		return Engine::max();
+	}
+
+	explicit lazy_isaac(result_type s = 0)
+	:
+	seed_(s)
+	{}
+
+	lazy_isaac(const lazy_isaac& rhs)
+	:
+	engine_(rhs.engine_ ? new Engine(*rhs.engine_) : nullptr),
+	seed_(rhs.seed_),
+	position_(rhs.position_)
+	{}
+
+	lazy_isaac(lazy_isaac&&) = default;
+
+	lazy_isaac&
+	operator=(const lazy_isaac& rhs)
+	{
+		if (this != &rhs)
+		{
+			*this = lazy_isaac(rhs);
+		}
+		return *this;
+	}
+
+	lazy_isaac& operator=(lazy_isaac&&) = default;
+
+	/*
+		Restarts the sequence of Engine seeded with s, leaving the engine dormant.
+	*/
+	void
+	seed(result_type s = 0)
+	{
+		engine_.reset();
+		seed_ = s;
+		position_ = 0;
+	}
+
+	inline result_type
+	operator()()
+	{
+		return engine()();
+	}
+
+	/*
+		A dormant engine just moves its position.
+	*/
+	inline void
+	discard(unsigned long long z)
+	{
+		if (engine_)
+		{
+			engine_->discard(z);
+		}
+		else
+		{
+			position_ += z;
+		}
+	}
+
+	template<class ForwardIt>
+	inline void
+	generate(ForwardIt first, ForwardIt last)
+	{
+		engine().generate(first, last);
+	}
+
+	/*
+		Constructs the engine now, rather than on the next draw.
+	*/
+	void
+	materialize()
+	{
+		if (!engine_)
+		{
+			engine_.reset(new Engine(seed_));
+			engine_->discard(position_);
+		}
+	}
+
+	/*
+		Releases the engine's state, keeping its position. A word that fill_bytes()
+		of the engine had only partly used is dropped; the remaining results of
+		the current block are not.
+	*/
+	void
+	demote()
+	{
+		if (engine_)
+		{
+			position_ = engine_->position();
+			engine_.reset();
+		}
+	}
+
+	bool
+	is_materialized() const
+	{
+		return static_cast<bool>(engine_);
+	}
+
+	/*
+		The number of values consumed since seeding.
+	*/
+	std::uint64_t
+	position() const
+	{
+		return engine_ ? engine_->position() : position_;
+	}
+
+	result_type
+	seed_value() const
+	{
+		return seed_;
+	}
+
+	friend bool
+	operator==(const lazy_isaac& x, const lazy_isaac& y)
+	{
+		return x.seed_ == y.seed_ && x.position() == y.position();
+	}
+
+	friend bool
+	operator!=(const lazy_isaac& x, const lazy_isaac& y)
+	{
+		return !(x == y);
+	}
+
+private:
+
+	inline Engine&
+	engine()
+	{
+		if (!engine_)
+		{
+			materialize();
+		}
+		return *engine_;
+	}
+
+	std::unique_ptr<Engine> engine_;
+	result_type seed_;
+	std::uint64_t position_ = 0;	/* while dormant */
+};
+
+}
+
+#endif /* guard_utils_isaac_lazy_h */
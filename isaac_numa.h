@@ -0,0 +1,241 @@
+/*
+	NUMA-aware placement of ISAAC engine state.
+
+	On a multi-socket host, an engine whose state is in another socket's memory pays
+	remote latency on every lookup into memory_ while it generates a block. The
+	allocator here places an engine's state on a chosen NUMA node, by default the
+	node of the thread that constructs the engine, and touches it from that thread
+	so the pages are faulted in there. The policy is set with the mbind system call
+	directly, so nothing needs to be linked. Linux only; elsewhere the state is just
+	mapped and touched by the constructing thread.
+*/
+
+#ifndef guard_utils_isaac_numa_h
+#define guard_utils_isaac_numa_h
+
+#include "isaac.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+namespace utils
+{
+
+/*
+	The NUMA node of the CPU the calling thread is running on, or -1 if it
+	isn't known.
+*/
+inline int
+isaac_numa_node()
+{
+#if defined(__linux__) && defined(SYS_getcpu)
+	unsigned int cpu, node;
+	if (::syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+	{
+		return static_cast<int>(node);
+	}
+#endif
+	return -1;
+}
+
+/*
+	The number of NUMA nodes the system can have; 1 where that isn't known.
+*/
+inline int
+isaac_numa_node_count()
+{
+	int count = 1;
+#if defined(__linux__)
+	/* a list of ranges, like "0-1,3"; the last number is the highest node */
+	if (std::FILE* f = std::fopen("/sys/devices/system/node/possible", "r"))
+	{
+		char list[256];
+		if (std::fgets(list, sizeof(list), f))
+		{
+			const char* p = list + std::strlen(list);
+			while (p > list && (p[-1] < '0' || p[-1] > '9'))
+			{
+				--p;
+			}
+			while (p > list && p[-1] >= '0' && p[-1] <= '9')
+			{
+				--p;
+			}
+			count = std::atoi(p) + 1;
+		}
+		std::fclose(f);
+	}
+#endif
+	return count;
+}
+
+/************************************************************
+isaac_numa_allocator maps each allocation as whole pages,
+sets their policy to prefer the allocator's node, and writes
+to every page, so they are faulted in by the allocating
+thread, on that node. A node of -1 stands for the node of the
+thread that calls allocate(); a copy of an engine therefore
+stays on its original node, unless the allocator was -1.
+Requests are rounded up to whole pages, so each engine takes
+at least a page: suited to engines with Alpha of 8, or to
+arrays of engines, rather than many small ones.
+*************************************************************/
+
+template<class T>
+class isaac_numa_allocator
+{
+public:
+	using value_type = T;
+
+	template<class U>
+	struct rebind
+	{
+		using other = isaac_numa_allocator<U>;
+	};
+
+	explicit isaac_numa_allocator(int node = -1) noexcept
+	:
+	node_(node)
+	{}
+
+	template<class U>
+	isaac_numa_allocator(const isaac_numa_allocator<U>& rhs) noexcept
+	:
+	node_(rhs.node())
+	{}
+
+	T*
+	allocate(std::size_t n)
+	{
+		std::size_t bytes = mapping_size(n);
+		void* p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+		{
+			throw std::bad_alloc();
+		}
+		bind(p, bytes, node_ >= 0 ? node_ : isaac_numa_node());
+		for (std::size_t offset = 0; offset < bytes; offset += page_size())
+		{
+			static_cast<volatile unsigned char*>(p)[offset] = 0;
+		}
+		return static_cast<T*>(p);
+	}
+
+	void
+	deallocate(T* p, std::size_t n) noexcept
+	{
+		::munmap(p, mapping_size(n));
+	}
+
+	/*
+		The node allocations are placed on, or -1 for the allocating thread's.
+	*/
+	int
+	node() const
+	{
+		return node_;
+	}
+
+private:
+
+	static std::size_t
+	page_size()
+	{
+		static const std::size_t size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+		return size;
+	}
+
+	static std::size_t
+	mapping_size(std::size_t n)
+	{
+		return (n * sizeof(T) + page_size() - 1) & ~(page_size() - 1);
+	}
+
+	/*
+		Sets the policy of the (untouched) mapping to prefer node. Failure is
+		ignored: the pages are then placed by the default policy, which puts
+		them on the node of the thread that touches them first.
+	*/
+	static void
+	bind(void* p, std::size_t bytes, int node)
+	{
+#if defined(__linux__) && defined(SYS_mbind)
+		if (node < 0)
+		{
+			return;
+		}
+		constexpr std::size_t word_bits = sizeof(unsigned long) * 8;
+		unsigned long mask[(1024 + word_bits - 1) / word_bits] = {};
+		std::size_t n = static_cast<std::size_t>(node);
+		if (n >= sizeof(mask) * 8)
+		{
+			return;
+		}
+		mask[n / word_bits] |= 1UL << (n % word_bits);
+		/* the kernel counts maxnode one past the last bit it reads */
+		::syscall(SYS_mbind, p, bytes, MPOL_PREFERRED, mask, sizeof(mask) * 8 + 1, 0);
+#else
+		(void)p;
+		(void)bytes;
+		(void)node;
+#endif
+	}
+
+	int node_;
+};
+
+template<class T, class U>
+inline bool
+operator==(const isaac_numa_allocator<T>& x, const isaac_numa_allocator<U>& y)
+{
+	return x.node() == y.node();
+}
+
+template<class T, class U>
+inline bool
+operator!=(const isaac_numa_allocator<T>& x, const isaac_numa_allocator<U>& y)
+{
+	return !(x == y);
+}
+
+using isaac_numa_storage = isaac_allocator_storage<isaac_numa_allocator<unsigned char>>;
+
+template<std::size_t Alpha = 8>
+using numa_isaac = isaac<Alpha, isaac_numa_storage>;
+
+template<std::size_t Alpha = 8>
+using numa_isaac64 = isaac64<Alpha, isaac_numa_storage>;
+
+/*
+	Constructs an Engine with NUMA storage (numa_isaac or numa_isaac64) whose
+	state is on node, passing args to its constructor.
+*/
+template<class Engine, class... Args>
+inline Engine
+make_isaac_on_node(int node, Args&&... args)
+{
+	return Engine(std::allocator_arg, isaac_numa_allocator<unsigned char>(node), std::forward<Args>(args)...);
+}
+
+/*
+	As make_isaac_on_node(), on the node of the calling thread; a thread that
+	will draw from the engine should construct it.
+*/
+template<class Engine, class... Args>
+inline Engine
+make_local_isaac(Args&&... args)
+{
+	return make_isaac_on_node<Engine>(isaac_numa_node(), std::forward<Args>(args)...);
+}
+
+}
+
+#endif /* guard_utils_isaac_numa_h */
@@ -0,0 +1,152 @@
+/*
+	An allocator that maps whole pages, optionally backed by 2 MB huge pages.
+
+	A large array of engines, such as a bank with one engine per task, is read at
+	scattered places, one block of state per engine, so with 4 KB pages nearly every
+	refill of an engine misses the TLB. Backing the array with huge pages covers it
+	with a few hundred TLB entries instead of thousands. POSIX only; huge pages are
+	used where the system provides them (Linux), and are otherwise silently skipped.
+*/
+
+#ifndef guard_utils_isaac_page_allocator_h
+#define guard_utils_isaac_page_allocator_h
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace utils
+{
+
+/************************************************************
+isaac_page_allocator allocates each request as its own
+mapping of whole pages, so memory is page-aligned (which
+satisfies isaac_aligned_storage) and is returned to the
+system when deallocated. If HugePages is true, requests are
+rounded up to a multiple of 2 MB and mapped from the huge
+page pool if one is reserved, or else aligned to 2 MB and
+marked for transparent huge pages. Requests are rounded up
+to whole pages either way, so the allocator is meant for a
+few large arrays, e.g. as the allocator of a std::vector of
+engines, and not as an engine's storage allocator.
+*************************************************************/
+
+template<class T, bool HugePages = true>
+class isaac_page_allocator
+{
+public:
+	using value_type = T;
+
+	template<class U>
+	struct rebind
+	{
+		using other = isaac_page_allocator<U, HugePages>;
+	};
+
+	static constexpr std::size_t huge_page_size = std::size_t(1) << 21;
+
+	isaac_page_allocator() = default;
+
+	template<class U>
+	isaac_page_allocator(const isaac_page_allocator<U, HugePages>&) noexcept
+	{}
+
+	T*
+	allocate(std::size_t n)
+	{
+		void* p = map(mapping_size(n));
+		if (p == nullptr)
+		{
+			throw std::bad_alloc();
+		}
+		return static_cast<T*>(p);
+	}
+
+	void
+	deallocate(T* p, std::size_t n) noexcept
+	{
+		::munmap(p, mapping_size(n));
+	}
+
+private:
+
+	static std::size_t
+	mapping_size(std::size_t n)
+	{
+		std::size_t granularity = HugePages ? huge_page_size : page_size();
+		return (n * sizeof(T) + granularity - 1) & ~(granularity - 1);
+	}
+
+	static std::size_t
+	page_size()
+	{
+		static const std::size_t size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+		return size;
+	}
+
+	static void*
+	map(std::size_t bytes)
+	{
+		void* p;
+#if defined(MAP_HUGETLB)
+		if (HugePages)
+		{
+			p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+			if (p != MAP_FAILED)
+			{
+				return p;
+			}
+		}
+#endif
+		if (!HugePages)
+		{
+			p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			return p != MAP_FAILED ? p : nullptr;
+		}
+
+		/*
+			Transparent huge pages are only used for 2 MB-aligned ranges, so map
+			an extra huge page's worth and trim the ends to an aligned range.
+		*/
+		std::size_t extra = huge_page_size;
+		p = ::mmap(nullptr, bytes + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+		{
+			return nullptr;
+		}
+		std::uintptr_t start = reinterpret_cast<std::uintptr_t>(p);
+		std::uintptr_t aligned = (start + huge_page_size - 1) & ~(std::uintptr_t(huge_page_size) - 1);
+		if (aligned > start)
+		{
+			::munmap(p, aligned - start);
+		}
+		if (aligned + bytes < start + bytes + extra)
+		{
+			::munmap(reinterpret_cast<void*>(aligned + bytes), start + extra - aligned);
+		}
+#if defined(MADV_HUGEPAGE)
+		::madvise(reinterpret_cast<void*>(aligned), bytes, MADV_HUGEPAGE);
+#endif
+		return reinterpret_cast<void*>(aligned);
+	}
+};
+
+template<class T, class U, bool HugePages>
+inline bool
+operator==(const isaac_page_allocator<T, HugePages>&, const isaac_page_allocator<U, HugePages>&)
+{
+	return true;
+}
+
+template<class T, class U, bool HugePages>
+inline bool
+operator!=(const isaac_page_allocator<T, HugePages>&, const isaac_page_allocator<U, HugePages>&)
+{
+	return false;
+}
+
+}
+
+#endif /* guard_utils_isaac_page_allocator_h */
@@ -0,0 +1,308 @@
+/*
+	A shared ISAAC generator with one engine per CPU.
+
+	Thread-local engines suit long-lived threads, but a program that runs many short
+	tasks on short-lived threads constructs (and seeds) an engine per thread, and keeps
+	as many states as it has threads. A per-CPU generator keeps one engine for each CPU
+	instead, shared by every thread that runs there. On x86-64 Linux, a draw takes the
+	next value from the current CPU's block inside a restartable sequence (rseq), which
+	the kernel aborts and restarts if the thread is preempted or migrated before it
+	commits, so drawing takes no lock and no atomic instruction. Elsewhere, or where
+	rseq isn't registered, each engine is guarded by its own mutex, chosen by the CPU
+	the thread is running on, so contention stays low.
+*/
+
+#ifndef guard_utils_isaac_percpu_h
+#define guard_utils_isaac_percpu_h
+
+#include "isaac.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/sysinfo.h>
+#endif
+
+#if defined(__linux__) && defined(__x86_64__) && defined(__GNUC__) && defined(__has_include)
+#if __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#if defined(RSEQ_SIG)
+#define UTILS_ISAAC_RSEQ
+#endif
+#endif
+#endif
+
+namespace utils
+{
+
+#if defined(UTILS_ISAAC_RSEQ)
+
+#define UTILS_ISAAC_STR_(x) #x
+#define UTILS_ISAAC_STR(x) UTILS_ISAAC_STR_(x)
+
+/*
+	Restartable sequences that pop the next value from a per-CPU block: if the
+	calling thread is still on cpu, and *count isn't zero, they store
+	(*data)[*count - 1] at *out and decrement *count, the decrement being the
+	commit. *data is read after *count, so a block published by another CPU is
+	seen whole. They return 0 on success, 1 if the block is empty, and 2 if the
+	sequence was aborted, in which case nothing was committed. The descriptor
+	and abort handler follow the layout the kernel and librseq use on x86-64.
+*/
+#define UTILS_ISAAC_RSEQ_POP(type, mov, scale, reg)                               \
+inline int                                                                         \
+_isaac_rseq_pop(struct rseq* rs, std::uint32_t cpu, std::size_t* count,            \
+	const type* const* data, type* out)                                            \
+{                                                                                  \
+	__asm__ goto(                                                                  \
+		".pushsection __rseq_cs, \"aw\"\n\t"                                       \
+		".balign 32\n\t"                                                           \
+		"3:\n\t"                                                                   \
+		".long 0x0, 0x0\n\t"                                                       \
+		".quad 1f, (2f - 1f), 4f\n\t"                                              \
+		".popsection\n\t"                                                          \
+		"leaq 3b(%%rip), %%rax\n\t"                                                \
+		"movq %%rax, %[rseq_cs]\n\t"                                               \
+		"1:\n\t"                                                                   \
+		"cmpl %[cpu], %[cpu_id]\n\t"                                               \
+		"jnz 4f\n\t"                                                               \
+		"movq (%[count]), %%rax\n\t"                                               \
+		"testq %%rax, %%rax\n\t"                                                   \
+		"jz %l[empty]\n\t"                                                         \
+		"subq $1, %%rax\n\t"                                                       \
+		"movq (%[data]), %%rcx\n\t"                                                \
+		mov " (%%rcx, %%rax, " scale "), " reg "\n\t"                              \
+		mov " " reg ", (%[out])\n\t"                                               \
+		"movq %%rax, (%[count])\n\t"                                               \
+		"2:\n\t"                                                                   \
+		".pushsection __rseq_failure, \"ax\"\n\t"                                  \
+		".byte 0x0f, 0xb9, 0x3d\n\t"                                               \
+		".long " UTILS_ISAAC_STR(RSEQ_SIG) "\n\t"                                  \
+		"4:\n\t"                                                                   \
+		"jmp %l[aborted]\n\t"                                                      \
+		".popsection\n\t"                                                          \
+		:                                                                          \
+		: [cpu] "r" (cpu), [cpu_id] "m" (rs->cpu_id), [rseq_cs] "m" (rs->rseq_cs), \
+		  [count] "r" (count), [data] "r" (data), [out] "r" (out)                  \
+		: "memory", "cc", "rax", "rcx"                                             \
+		: empty, aborted);                                                         \
+	return 0;                                                                      \
+empty:                                                                             \
+	return 1;                                                                      \
+aborted:                                                                           \
+	return 2;                                                                      \
+}
+
+UTILS_ISAAC_RSEQ_POP(std::uint32_t, "movl", "4", "%%ecx")
+UTILS_ISAAC_RSEQ_POP(std::uint64_t, "movq", "8", "%%rcx")
+
+#undef UTILS_ISAAC_RSEQ_POP
+#undef UTILS_ISAAC_STR
+#undef UTILS_ISAAC_STR_
+
+inline struct rseq*
+_isaac_rseq_area()
+{
+	return reinterpret_cast<struct rseq*>(static_cast<char*>(__builtin_thread_pointer()) + __rseq_offset);
+}
+
+#endif
+
+/************************************************************
+isaac_percpu<Engine> draws from the engine of the CPU the
+calling thread runs on. The engine for CPU k is constructed
+when a thread first draws on CPU k, seeded as Engine seeded
+with the two words { master, k } (as isaac_pool<Engine> seeds
+the engine of ordinal k). Which thread receives which value
+depends on scheduling, so unlike per-thread engines, a
+multi-threaded run is not reproducible; each value is still
+drawn exactly once. uses_rseq() reports whether draws use
+restartable sequences; that is decided once, for the process,
+because glibc registers rseq for every thread or for none.
+*************************************************************/
+
+template<class Engine = isaac64<>>
+class isaac_percpu
+{
+public:
+	using engine_type = Engine;
+
+	using result_type = typename Engine::result_type;
+
+	static_assert(_isaac_new_aligns<Engine>::value, "before C++17, new doesn't align engines with isaac_aligned_storage");
+
+	static constexpr result_type min()
+	{
+		return Engine::min();
+	}
+	static constexpr result_type max()
+	{
+		return Engine::max();
+	}
+
+	explicit isaac_percpu(result_type master = 0)
+	:
+	master_(master),
+	size_(cpu_count()),
+	slots_(new slot[size_])
+	{}
+
+	isaac_percpu(const isaac_percpu&) = delete;
+	isaac_percpu& operator=(const isaac_percpu&) = delete;
+
+	inline result_type
+	operator()()
+	{
+#if defined(UTILS_ISAAC_RSEQ)
+		if (uses_rseq())
+		{
+			struct rseq* rs = _isaac_rseq_area();
+			for (;;)
+			{
+				std::uint32_t cpu = __atomic_load_n(&rs->cpu_id_start, __ATOMIC_RELAXED);
+				if (cpu >= size_)
+				{
+					return draw_locked(size_);
+				}
+				slot& s = slots_[cpu];
+				result_type r;
+				int status = _isaac_rseq_pop(rs, cpu, &s.count, &s.data, &r);
+				if (status == 0)
+				{
+					return r;
+				}
+				if (status == 1)
+				{
+					std::lock_guard<std::mutex> lock(s.mutex);
+					if (__atomic_load_n(&s.count, __ATOMIC_ACQUIRE) == 0)
+					{
+						next_block(s, cpu);
+					}
+				}
+			}
+		}
+#endif
+		return draw_locked(current_cpu() % size_);
+	}
+
+	/*
+		The number of engines that can exist: one per possible CPU.
+	*/
+	std::size_t
+	size() const
+	{
+		return size_;
+	}
+
+	static bool
+	uses_rseq()
+	{
+#if defined(UTILS_ISAAC_RSEQ)
+		return __rseq_size > 0;
+#else
+		return false;
+#endif
+	}
+
+private:
+
+	/*
+		A CPU's engine, and the block it is drawing from. count is the number of
+		values left in the block, and is zero until the engine is constructed.
+		Under rseq, count is only changed by threads running on this slot's
+		CPU, or by next_block(), which only runs when count is zero, under the
+		mutex.
+		Otherwise, everything is guarded by the mutex. The padding keeps the
+		count and data of neighbouring slots a cache line apart, so that CPUs
+		drawing from them don't share a line.
+	*/
+	struct slot
+	{
+		std::size_t count = 0;
+		const result_type* data = nullptr;
+		char padding[64 - sizeof(std::size_t) - sizeof(void*)];
+		std::mutex mutex;
+		std::unique_ptr<Engine> engine;
+	};
+
+	static std::size_t
+	cpu_count()
+	{
+#if defined(__linux__)
+		int n = ::get_nprocs_conf();
+		return n > 0 ? static_cast<std::size_t>(n) : 1;
+#else
+		unsigned n = std::thread::hardware_concurrency();
+		return n > 0 ? n : 1;
+#endif
+	}
+
+	/*
+		The CPU the thread is running on, or a hash of the thread's id where
+		that isn't known.
+	*/
+	static std::size_t
+	current_cpu()
+	{
+#if defined(__linux__)
+		int cpu = ::sched_getcpu();
+		if (cpu >= 0)
+		{
+			return static_cast<std::size_t>(cpu);
+		}
+#endif
+		return std::hash<std::thread::id>()(std::this_thread::get_id());
+	}
+
+	/*
+		Starts the next block of s, under its mutex. The engine's own count is
+		left at the size of the block while the block is drawn from s.count, so
+		the values drawn are marked consumed here, before the next block is
+		generated.
+	*/
+	void
+	next_block(slot& s, std::size_t cpu)
+	{
+		if (!s.engine)
+		{
+			result_type words[2] = { master_, static_cast<result_type>(cpu) };
+			s.engine.reset(new Engine(words, words + 2));
+		}
+		else
+		{
+			s.engine->release();
+		}
+		typename Engine::block_view block = s.engine->lease();
+		s.data = block.data;
+		__atomic_store_n(&s.count, block.size, __ATOMIC_RELEASE);
+	}
+
+	/*
+		Draws from the engine of cpu under its mutex; cpu may be size_, for
+		the overflow engine.
+	*/
+	result_type
+	draw_locked(std::size_t cpu)
+	{
+		slot& s = cpu < size_ ? slots_[cpu] : overflow_;
+		std::lock_guard<std::mutex> lock(s.mutex);
+		if (s.count == 0)
+		{
+			next_block(s, cpu);
+		}
+		return s.data[--s.count];
+	}
+
+	result_type master_;
+	std::size_t size_;
+	std::unique_ptr<slot[]> slots_;
+	slot overflow_;	/* for CPUs numbered beyond size_, which can only appear by hotplug */
+};
+
+}
+
+#endif /* guard_utils_isaac_percpu_h */
@@ -0,0 +1,195 @@
+/*
+	Per-thread ISAAC engines, seeded deterministically from a master seed.
+
+	A pool gives each thread that draws from it an engine of its own, constructed on
+	the thread's first draw, so threads never contend for an engine, and no thread
+	pays for seeding from std::random_device. The engine of a thread is seeded from
+	the pool's master seed and the thread's ordinal, so a multi-threaded run with a
+	fixed master seed is reproducible, provided each thread's ordinal is too.
+*/
+
+#ifndef guard_utils_isaac_pool_h
+#define guard_utils_isaac_pool_h
+
+#include "isaac.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace utils
+{
+
+/************************************************************
+isaac_pool<Engine> constructs the engine of ordinal k as
+Engine seeded with the two words { master, k }, so that
+make(k) reproduces it anywhere. A thread's ordinal is either
+given explicitly, by its first call of local(ordinal), or
+assigned by its first call of local(), in the order in which
+threads first draw. Threads that start in a fixed order, or
+that pass their own index (a worker number, say), therefore
+get the same engines on every run. Explicit ordinals are not
+reserved, so a pool should use one scheme or the other. The
+engines belong to the pool, which must outlive the threads'
+use of them. After a thread's first draw, finding its engine
+takes a thread-local lookup, and no lock.
+*************************************************************/
+
+template<class Engine = isaac64<>>
+class isaac_pool
+{
+public:
+	using engine_type = Engine;
+
+	using result_type = typename Engine::result_type;
+
+	static_assert(_isaac_new_aligns<Engine>::value, "before C++17, new doesn't align engines with isaac_aligned_storage");
+
+	explicit isaac_pool(result_type master = 0)
+	:
+	master_(master),
+	id_(next_id()),
+	alive_(std::make_shared<char>())
+	{}
+
+	isaac_pool(const isaac_pool&) = delete;
+	isaac_pool& operator=(const isaac_pool&) = delete;
+
+	/*
+		The calling thread's engine; on the thread's first call, a new engine
+		with the next unused ordinal.
+	*/
+	inline Engine&
+	local()
+	{
+		cached& last = last_used();
+		if (last.id == id_)
+		{
+			return *last.engine;
+		}
+		return find_or_create(nullptr);
+	}
+
+	/*
+		The calling thread's engine; on the thread's first call, the engine of
+		the given ordinal. Two threads given the same ordinal draw the same
+		sequence. Later calls ignore the ordinal.
+	*/
+	Engine&
+	local(std::size_t ordinal)
+	{
+		cached& last = last_used();
+		if (last.id == id_)
+		{
+			return *last.engine;
+		}
+		return find_or_create(&ordinal);
+	}
+
+	/*
+		A standalone engine in the initial state of the engine of ordinal k.
+	*/
+	Engine
+	make(std::size_t ordinal) const
+	{
+		result_type words[2] = { master_, static_cast<result_type>(ordinal) };
+		return Engine(words, words + 2);
+	}
+
+	result_type
+	master_seed() const
+	{
+		return master_;
+	}
+
+	/*
+		The number of engines constructed so far.
+	*/
+	std::size_t
+	size() const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return engines_.size();
+	}
+
+private:
+
+	/*
+		Each thread remembers the engines it has drawn from, by the id of their
+		pool. Ids are never reused, so the entry of a destroyed pool is never
+		matched again; it is dropped the next time the thread looks for an
+		engine it hasn't just used, so a thread only keeps entries for the
+		live pools it has drawn from.
+	*/
+	struct cached
+	{
+		std::uint64_t id;
+		Engine* engine;
+	};
+
+	struct thread_entry
+	{
+		cached engine;
+		std::weak_ptr<char> pool;	/* expires with the pool */
+	};
+
+	static std::uint64_t
+	next_id()
+	{
+		static std::atomic<std::uint64_t> id(1);
+		return id++;
+	}
+
+	static cached&
+	last_used()
+	{
+		static thread_local cached last = { 0, nullptr };
+		return last;
+	}
+
+	static std::vector<thread_entry>&
+	thread_engines()
+	{
+		static thread_local std::vector<thread_entry> engines;
+		return engines;
+	}
+
+	Engine&
+	find_or_create(const std::size_t* ordinal)
+	{
+		std::vector<thread_entry>& engines = thread_engines();
+		engines.erase(std::remove_if(engines.begin(), engines.end(),
+			[](const thread_entry& e) { return e.pool.expired(); }), engines.end());
+		for (const thread_entry& e : engines)
+		{
+			if (e.engine.id == id_)
+			{
+				last_used() = e.engine;
+				return *e.engine.engine;
+			}
+		}
+
+		std::size_t k = ordinal ? *ordinal : next_ordinal_++;
+		std::unique_ptr<Engine> e(new Engine(make(k)));
+		cached c = { id_, e.get() };
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			engines_.push_back(std::move(e));
+		}
+		engines.push_back(thread_entry{ c, alive_ });
+		last_used() = c;
+		return *c.engine;
+	}
+
+	result_type master_;
+	std::uint64_t id_;
+	std::shared_ptr<char> alive_;
+	mutable std::mutex mutex_;
+	std::atomic<std::size_t> next_ordinal_{0};
+	std::vector<std::unique_ptr<Engine>> engines_;
+};
+
+}
+
+#endif /* guard_utils_isaac_pool_h */
@@ -1,37 +1,167 @@
 #include <iostream>
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <thread>
 #include "isaac.h"
+#include "isaac_async.h"
+#include "isaac_lanes.h"
+#include "isaac_bank.h"
+#include "isaac_entropy.h"
+#include "isaac_file_bank.h"
+#include "isaac_lazy.h"
+#include "isaac_fork.h"
+#include "isaac_incremental.h"
+#include "isaac_numa.h"
+#include "isaac_percpu.h"
+#include "isaac_page_allocator.h"
+#include "isaac_pool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 template<class Gen>
-std::uint64_t time_rand(Gen gen, std::size_t num_bytes, std::uint64_t& val)
+std::uint64_t time_rand(Gen& gen, std::size_t num_bytes, std::uint64_t& val)
 {
 	std::size_t count = num_bytes / sizeof(typename Gen::result_type);
+	std::uint64_t sum = 0;
+	auto start = std::chrono::system_clock::now();
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		// accumulating the results prevents the optimizer from eliminating
+		// the loop entirely, which it is prone to do; a local is used because
+		// val could alias the state of gen, which would force a store per call
+		sum += gen();
+	}
+	auto finish = std::chrono::system_clock::now();
+	val += sum;
+	auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(finish - start);
+	return elapsed_ms.count();
+}
+
+// Draws one value from each engine of a bank in turn, as when each of many
+// tasks owns an engine, so that consecutive draws touch different engines
+
+template<class Bank>
+std::uint64_t time_bank(Bank& bank, std::size_t num_bytes, std::uint64_t& val)
+{
+	std::size_t count = num_bytes / sizeof(typename Bank::value_type::result_type) / bank.size();
+	std::uint64_t sum = 0;
 	auto start = std::chrono::system_clock::now();
 	for (std::size_t i = 0; i < count; ++i)
 	{
-		// assigning the result to val prevents the optimizer
-		// from eliminating the loop entirely, which it is prone to do
-		val += gen();
+		for (auto& gen : bank)
+		{
+			sum += gen();
+		}
 	}
 	auto finish = std::chrono::system_clock::now();
+	val += sum;
 	auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(finish - start);
 	return elapsed_ms.count();
 }
 
-template<class Generator>
-inline void
-random_fill(Generator& gen, unsigned char* buf, std::size_t count)
+// Timestamps for timing single calls: the time-stamp counter, in cycles, on
+// x86, and the steady clock, in nanoseconds, elsewhere
+
+#if defined(__x86_64__) || defined(__i386__)
+static const char* call_time_unit = "cycles";
+
+inline std::uint64_t call_time()
+{
+	return __rdtsc();
+}
+#else
+static const char* call_time_unit = "ns";
+
+inline std::uint64_t call_time()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+// Returns the median, the 99.9th percentile and the slowest of count calls,
+// in units of call_time(); the overhead of reading the timestamps is included
+
+template<class Gen>
+std::array<std::uint64_t, 3> time_calls(Gen& gen, std::size_t count, std::uint64_t& val)
+{
+	std::vector<std::uint64_t> call_times(count);
+	std::uint64_t sum = 0;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		auto start = call_time();
+		sum += gen();
+		auto finish = call_time();
+		call_times[i] = finish - start;
+	}
+	val += sum;
+	std::sort(call_times.begin(), call_times.end());
+	return {{ call_times[count / 2], call_times[count - count / 1000], call_times[count - 1] }};
+}
+
+// Returns true if the precomputed values with which an engine starts seeding
+// are the golden ratio scrambled by four rounds of mix(), as the original
+// seeding routine computes them
+
+template<class Engine>
+bool check_golden_mix(typename Engine::result_type golden)
 {
-	static constexpr std::size_t word_size = sizeof(typename Generator::result_type);
-	unsigned char* p = buf;
-	unsigned char* limit = p + count;
-	while (p < limit)
+	struct scrambler : Engine
+	{
+		using Engine::golden_mix;
+		using Engine::mix;
+	};
+	scrambler s;
+	typename Engine::result_type w[8];
+	std::fill(w, w + 8, golden);
+	for (int i = 0; i < 4; ++i)
 	{
-		auto word = gen();
-		auto n = std::min(static_cast<std::size_t>(limit - p), word_size);
-		::memcpy(p, &word, n);
-		p += n;
+		s.mix(w[0], w[1], w[2], w[3], w[4], w[5], w[6], w[7]);
 	}
+	return std::equal(w, w + 8, scrambler::golden_mix());
+}
+
+// Returns true if two engines produce the same next count values
+
+template<class Gen1, class Gen2>
+bool same_sequence(Gen1& x, Gen2& y, std::size_t count)
+{
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		if (x() != y())
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// Returns true if every lane of a multi-lane engine produces the sequence
+// of a scalar engine constructed with the corresponding seed
+
+template<class Lanes>
+bool check_lanes(const std::array<typename Lanes::result_type, Lanes::lanes>& seeds)
+{
+	Lanes gen{seeds};
+	std::vector<typename Lanes::engine_type> lane_check;
+	for (auto s : seeds)
+	{
+		lane_check.emplace_back(s);
+	}
+	for (std::size_t j = 0; j < 100000; j++)
+	{
+		auto lane = Lanes::lanes - 1 - j % Lanes::lanes;
+		if (gen() != lane_check[lane]())
+		{
+			std::cout << "mismatch in lane " << lane << " at " << j << std::endl;
+			return false;
+		}
+	}
+	return true;
 }
 
 int main(int argc, const char * argv[])
@@ -63,21 +193,795 @@ int main(int argc, const char * argv[])
 	
 	std::cout << "generating 2^30 bytes, isaac64 = " << isaac_ms << " ms, mt19937_64 = " << mt_ms << " ms" << std::endl;
 
+	// Seeding starts from a precomputed table; a mistyped entry would change
+	// every seeded sequence
+
+	if (!check_golden_mix<utils::isaac<alpha>>(0x9e3779b9) || !check_golden_mix<utils::isaac64<alpha>>(0x9e3779b97f4a7c13))
+	{
+		std::cout << "golden ratio table mismatch" << std::endl;
+		return 1;
+	}
+
+	// generate() must give the values of repeated operator()() calls, whether
+	// it writes through a pointer or another iterator, for lengths that aren't
+	// whole blocks, starting part way through a block
+
+	for (std::size_t skip : { 0, 1, 100 })
+	{
+		for (std::size_t length : { 1, 255, 256, 257, 1000 })
+		{
+			utils::isaac64<alpha> pointer_gen{igen};
+			utils::isaac64<alpha> iterator_gen{igen};
+			utils::isaac64<alpha> call_gen{igen};
+			pointer_gen.discard(skip);
+			iterator_gen.discard(skip);
+			call_gen.discard(skip);
+			std::vector<utils::isaac64<alpha>::result_type> pointer_values(length);
+			std::deque<utils::isaac64<alpha>::result_type> iterator_values(length);
+			pointer_gen.generate(pointer_values.data(), length);
+			iterator_gen.generate(iterator_values.begin(), iterator_values.end());
+			for (std::size_t i = 0; i <= length; ++i)
+			{
+				auto expected = call_gen();
+				if ((i < length && (pointer_values[i] != expected || iterator_values[i] != expected)) ||
+					(i == length && (pointer_gen() != expected || iterator_gen() != expected)))
+				{
+					std::cout << "generate mismatch at " << i << " of " << length << ", after skipping " << skip << std::endl;
+					return 1;
+				}
+			}
+		}
+	}
+
+	// lease() shows the values operator()() returns next, last first, without
+	// consuming them; release() consumes them, after which peek() is empty
+
+	utils::isaac64<alpha> lease_gen{igen};
+	utils::isaac64<alpha> lease_check{igen};
+	lease_gen.discard(5);
+	lease_check.discard(5);
+	for (std::size_t round = 0; round < 3; ++round)
+	{
+		auto leased = lease_gen.lease();
+		if (leased.size == 0 || lease_gen.peek().data != leased.data || lease_gen.peek().size != leased.size)
+		{
+			std::cout << "lease mismatch with peek in block " << round << std::endl;
+			return 1;
+		}
+		for (std::size_t i = leased.size; i-- > 0; )
+		{
+			if (leased.data[i] != lease_check())
+			{
+				std::cout << "lease mismatch at " << i << " in block " << round << std::endl;
+				return 1;
+			}
+		}
+		lease_gen.release();
+		if (lease_gen.peek().size != 0)
+		{
+			std::cout << "peek not empty after release in block " << round << std::endl;
+			return 1;
+		}
+	}
+	if (lease_gen() != lease_check())
+	{
+		std::cout << "lease mismatch after release" << std::endl;
+		return 1;
+	}
+
+	// checkpoint_index::seek() must leave an engine as the origin advanced by
+	// discard(): before the first checkpoint, exactly on one, and past the
+	// last one recorded, which records more
+
+	static constexpr std::size_t seek_interval = 4;
+	static constexpr std::uint64_t seek_span = seek_interval << alpha;
+
+	utils::isaac64<alpha> seek_origin{igen};
+	seek_origin.discard(3);
+	utils::checkpoint_index<utils::isaac64<alpha>> seek_index(seek_origin, seek_interval);
+	std::uint64_t first_checkpoint = seek_origin.position() + seek_origin.peek().size;
+
+	for (std::uint64_t position : { seek_origin.position(), seek_origin.position() + 10, first_checkpoint,
+		first_checkpoint + seek_span, first_checkpoint + 100 * seek_span + 7 })
+	{
+		utils::isaac64<alpha> seeked;
+		utils::isaac64<alpha> discarded{seek_origin};
+		discarded.discard(position - seek_origin.position());
+		if (!seek_index.seek(seeked, position) || seeked.position() != position || seeked != discarded || seeked() != discarded())
+		{
+			std::cout << "checkpoint_index mismatch at position " << position << std::endl;
+			return 1;
+		}
+	}
+	utils::isaac64<alpha> seek_before;
+	if (seek_index.seek(seek_before, seek_origin.position() - 1))
+	{
+		std::cout << "checkpoint_index sought before its origin" << std::endl;
+		return 1;
+	}
+
+	// the first seek to a distant position records the checkpoints up to it;
+	// later seeks only restore one and discard the rest
+
+	static constexpr std::uint64_t seek_position = 300000000;
+
+	utils::checkpoint_index<utils::isaac64<alpha>> far_index(utils::isaac64<alpha>{igen}, 1024);
+	utils::isaac64<alpha> far_gen;
+	auto seek_start = std::chrono::steady_clock::now();
+	far_index.seek(far_gen, seek_position);
+	value += far_gen();
+	auto seek_again = std::chrono::steady_clock::now();
+	far_index.seek(far_gen, seek_position);
+	value += far_gen();
+	auto seek_finish = std::chrono::steady_clock::now();
+
+	std::cout << "seeking " << seek_position << " values into isaac64 (a checkpoint every 1024 blocks), first = "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(seek_again - seek_start).count() << " ms, again = "
+		<< std::chrono::duration_cast<std::chrono::microseconds>(seek_finish - seek_again).count() << " us" << std::endl;
+
+	// load() of a snapshot written by save() must restore the engine, with
+	// the rest of a partly used fill_bytes() word; it must refuse snapshots
+	// of other engine types, and corrupted ones, leaving the engine unchanged
+
+	utils::isaac64<alpha> snapshot_gen{igen};
+	unsigned char snapshot_bytes[3];
+	snapshot_gen.fill_bytes(snapshot_bytes, sizeof(snapshot_bytes));
+	std::vector<unsigned char> snapshot(utils::isaac64<alpha>::snapshot_size());
+	snapshot_gen.save(snapshot.data());
+
+	utils::isaac64<alpha> restored_gen;
+	if (!restored_gen.load(snapshot.data()) || restored_gen != snapshot_gen)
+	{
+		std::cout << "snapshot round trip mismatch" << std::endl;
+		return 1;
+	}
+	unsigned char restored_bytes[sizeof(snapshot_bytes)];
+	snapshot_gen.fill_bytes(snapshot_bytes, sizeof(snapshot_bytes));
+	restored_gen.fill_bytes(restored_bytes, sizeof(snapshot_bytes));
+	if (::memcmp(snapshot_bytes, restored_bytes, sizeof(snapshot_bytes)) != 0 || snapshot_gen() != restored_gen())
+	{
+		std::cout << "snapshot round trip mismatch after loading" << std::endl;
+		return 1;
+	}
+
+	utils::isaac<alpha> other_word_gen;
+	utils::isaac64<4> other_alpha_gen;
+	utils::isaac64<alpha> corrupted_gen;
+	std::vector<unsigned char> corrupted(snapshot);
+	corrupted[0] ^= 1;
+	std::vector<unsigned char> wrong_version(snapshot);
+	wrong_version[4] += 1;
+	if (other_word_gen.load(snapshot.data()) || other_alpha_gen.load(snapshot.data()) ||
+		corrupted_gen.load(corrupted.data()) || corrupted_gen.load(wrong_version.data()) ||
+		other_word_gen != utils::isaac<alpha>{} || other_alpha_gen != utils::isaac64<4>{} || corrupted_gen != utils::isaac64<alpha>{})
+	{
+		std::cout << "snapshot of another engine type, or corrupted, was loaded" << std::endl;
+		return 1;
+	}
+
+	// The multi-lane engines step several isaac64 streams at once; each lane must
+	// match a scalar isaac64 with the same seed. Each instruction set the CPU
+	// supports is timed in turn.
+
+	static const char* isa_names[] = { "scalar", "avx2", "avx512" };
+
+	std::array<utils::isaac64<alpha>::result_type, 8> lane_seeds;
+	for (auto& s : lane_seeds)
+	{
+		s = igen();
+	}
+
+	for (auto isa : { utils::isaac_isa::scalar, utils::isaac_isa::avx2, utils::isaac_isa::avx512 })
+	{
+		if (!utils::force_isaac_isa(isa))
+		{
+			continue;
+		}
+
+		utils::isaac64_x8<alpha> lanes_gen{lane_seeds};
+
+		auto lanes_ms = time_rand(lanes_gen, 1 << 30, value);
+
+		std::cout << "generating 2^30 bytes, isaac64_x8 (" << isa_names[static_cast<int>(isa)] << ") = " << lanes_ms << " ms" << std::endl;
+
+		if (!check_lanes<utils::isaac64_x8<alpha>>(lane_seeds))
+		{
+			return 1;
+		}
+	}
+	utils::force_isaac_isa(utils::detect_isaac_isa());
+
+	// isaac64_ilp interleaves streams with plain integer instructions
+
+	std::array<utils::isaac64<alpha>::result_type, 4> ilp_seeds{{lane_seeds[0], lane_seeds[1], lane_seeds[2], lane_seeds[3]}};
+	utils::isaac64_ilp<alpha, 4> ilp_gen{ilp_seeds};
+
+	auto ilp_ms = time_rand(ilp_gen, 1 << 30, value);
+
+	std::cout << "generating 2^30 bytes, isaac64_ilp<4> = " << ilp_ms << " ms" << std::endl;
+
+	if (!check_lanes<utils::isaac64_ilp<alpha, 4>>(ilp_seeds))
+	{
+		return 1;
+	}
+
+	// An isaac_file_bank keeps engines in a memory-mapped file; once synced and
+	// reopened, each engine continues its sequence, and the file can't be
+	// opened as a bank of another engine type
+
+	static constexpr std::size_t file_bank_size = 1000;
+	static const char* file_bank_path = "isaac_check.bank";
+
+	std::vector<utils::isaac<4>> file_check;
+	{
+		utils::isaac_file_bank<utils::isaac<4>> file_bank;
+		if (!file_bank.create(file_bank_path, file_bank_size))
+		{
+			std::cout << "isaac_file_bank create failed" << std::endl;
+			return 1;
+		}
+		for (std::size_t i = 0; i < file_bank_size; ++i)
+		{
+			file_bank[i].seed(static_cast<std::uint32_t>(i));
+			file_bank[i].discard(i);
+			file_check.emplace_back(file_bank[i]);
+		}
+		if (!file_bank.sync())
+		{
+			std::cout << "isaac_file_bank sync failed" << std::endl;
+			return 1;
+		}
+	}
+	{
+		utils::isaac_file_bank<utils::isaac<4>> file_bank;
+		utils::isaac_file_bank<utils::isaac64<4>> wrong_bank;
+		if (!file_bank.open(file_bank_path) || file_bank.size() != file_bank_size || wrong_bank.open(file_bank_path))
+		{
+			std::cout << "isaac_file_bank open mismatch" << std::endl;
+			return 1;
+		}
+		for (std::size_t i = 0; i < file_bank_size; ++i)
+		{
+			if (file_bank[i]() != file_check[i]())
+			{
+				std::cout << "isaac_file_bank mismatch for engine " << i << std::endl;
+				return 1;
+			}
+		}
+	}
+	std::remove(file_bank_path);
+
+	// Engines with heap storage produce the sequence of inline engines, and
+	// keep it through moves and swaps, which only exchange the state's pointers
+
+	using heap_engine = utils::isaac64<alpha, utils::isaac_heap_storage>;
+
+	utils::isaac64<alpha>::result_type storage_seed = igen();
+	utils::isaac64<alpha> inline_gen{storage_seed};
+	utils::isaac64<alpha> inline_other{storage_seed + 1};
+	heap_engine heap_gen{storage_seed};
+	heap_engine heap_other{storage_seed + 1};
+	if (!same_sequence(heap_gen, inline_gen, 1000))
+	{
+		std::cout << "isaac_heap_storage mismatch" << std::endl;
+		return 1;
+	}
+	auto heap_state = heap_gen.peek().data;
+	heap_engine heap_moved{std::move(heap_gen)};
+	if (heap_moved.peek().data != heap_state || !same_sequence(heap_moved, inline_gen, 1000))
+	{
+		std::cout << "isaac_heap_storage mismatch after a move" << std::endl;
+		return 1;
+	}
+	heap_gen = std::move(heap_moved);
+	std::swap(heap_gen, heap_other);
+	if (heap_other.peek().data != heap_state || !same_sequence(heap_other, inline_gen, 1000) ||
+		!same_sequence(heap_gen, inline_other, 1000))
+	{
+		std::cout << "isaac_heap_storage mismatch after a swap" << std::endl;
+		return 1;
+	}
+
+	// Engines with allocator storage produce the same sequence; under C++17, a
+	// std::pmr::vector passes its memory resource on to the engines it holds,
+	// and to copies of them in another vector
+
+	using allocator_engine = utils::isaac64<alpha, utils::isaac_allocator_storage<std::allocator<unsigned char>>>;
+
+	allocator_engine allocator_gen{std::allocator_arg, std::allocator<unsigned char>(), storage_seed + 1};
+	utils::isaac64<alpha> allocator_check{storage_seed + 1};
+	if (!same_sequence(allocator_gen, allocator_check, 1000))
+	{
+		std::cout << "isaac_allocator_storage mismatch" << std::endl;
+		return 1;
+	}
+
+#if __cplusplus >= 201703L
+	static_assert(std::uses_allocator<utils::pmr::isaac64<alpha>, std::pmr::polymorphic_allocator<utils::pmr::isaac64<alpha>>>::value,
+		"pmr engines are allocator-aware");
+
+	std::pmr::monotonic_buffer_resource arena;
+	std::pmr::monotonic_buffer_resource other_arena;
+	std::pmr::vector<utils::pmr::isaac64<alpha>> pmr_engines(&arena);
+	for (std::size_t i = 0; i < 16; ++i)
+	{
+		pmr_engines.emplace_back(storage_seed + i);
+	}
+	std::pmr::vector<utils::pmr::isaac64<alpha>> pmr_copies(pmr_engines, &other_arena);
+	for (std::size_t i = 0; i < pmr_engines.size(); ++i)
+	{
+		utils::isaac64<alpha> pmr_check{storage_seed + i};
+		utils::isaac64<alpha> pmr_copy_check{storage_seed + i};
+		if (pmr_engines[i].get_allocator().resource() != &arena || pmr_copies[i].get_allocator().resource() != &other_arena ||
+			!same_sequence(pmr_engines[i], pmr_check, 1000) || !same_sequence(pmr_copies[i], pmr_copy_check, 1000))
+		{
+			std::cout << "pmr::isaac64 mismatch for engine " << i << std::endl;
+			return 1;
+		}
+	}
+#endif
+
+	// A bank of engines much larger than the caches, with the default layout,
+	// with cache-line aligned engines, and with aligned engines on huge pages
+
+	static constexpr std::size_t bank_size = 4096;
+
+	using aligned_engine = utils::isaac64<alpha, utils::isaac_aligned_storage<>>;
+
+	std::vector<utils::isaac64<alpha>> bank;
+	std::vector<aligned_engine, utils::isaac_page_allocator<aligned_engine, false>> aligned_bank;
+	std::vector<aligned_engine, utils::isaac_page_allocator<aligned_engine>> huge_page_bank;
+	bank.reserve(bank_size);
+	aligned_bank.reserve(bank_size);
+	huge_page_bank.reserve(bank_size);
+	for (std::size_t i = 0; i < bank_size; ++i)
+	{
+		bank.emplace_back(i);
+		aligned_bank.emplace_back(i);
+		huge_page_bank.emplace_back(i);
+	}
+
+	auto bank_ms = time_bank(bank, 1 << 30, value);
+	auto aligned_bank_ms = time_bank(aligned_bank, 1 << 30, value);
+	auto huge_page_bank_ms = time_bank(huge_page_bank, 1 << 30, value);
+
+	std::cout << "generating 2^30 bytes from " << bank_size << " engines, default = " << bank_ms << " ms, aligned = " << aligned_bank_ms
+		<< " ms, aligned on huge pages = " << huge_page_bank_ms << " ms" << std::endl;
+
+	if (!std::equal(aligned_bank.begin(), aligned_bank.end(), huge_page_bank.begin()) ||
+		!std::equal(bank.begin(), bank.end(), aligned_bank.begin(),
+			[](utils::isaac64<alpha>& x, aligned_engine& y) { return x() == y(); }))
+	{
+		std::cout << "mismatch between bank layouts" << std::endl;
+		return 1;
+	}
+
+	// An isaac_bank holds many small engines in structure-of-arrays groups, and
+	// draw_all() takes one value from each in a single pass; each engine must
+	// match a standalone isaac<4> with the same seed
+
+	static constexpr std::size_t agent_count = 1 << 16;
+
+	std::vector<utils::isaac<4>::result_type> agent_seeds(agent_count);
+	for (auto& s : agent_seeds)
+	{
+		s = static_cast<utils::isaac<4>::result_type>(igen());
+	}
+	utils::isaac_bank<4> agent_bank{agent_seeds};
+	std::vector<utils::isaac<4>> agents(agent_seeds.begin(), agent_seeds.end());
+	std::vector<utils::isaac<4>::result_type> draws(agent_count);
+
+	auto agents_ms = time_bank(agents, 1 << 28, value);
+
+	auto draw_start = std::chrono::system_clock::now();
+	for (std::size_t i = 0; i < (1 << 28) / sizeof(draws[0]) / agent_count; ++i)
+	{
+		agent_bank.draw_all(draws.data());
+		value += draws[i % agent_count];
+	}
+	auto draw_finish = std::chrono::system_clock::now();
+	auto agent_bank_ms = std::chrono::duration_cast<std::chrono::milliseconds>(draw_finish - draw_start).count();
+
+	std::cout << "generating 2^28 bytes from " << agent_count << " isaac<4> engines, separate = " << agents_ms
+		<< " ms, isaac_bank draw_all = " << agent_bank_ms << " ms" << std::endl;
+
+	agent_bank.draw_all(draws.data());
+	for (std::size_t i = 0; i < agent_count; ++i)
+	{
+		if (draws[i] != agents[i]())
+		{
+			std::cout << "isaac_bank mismatch for engine " << i << std::endl;
+			return 1;
+		}
+	}
+
+	// Drawing from the engines of a bank at uneven rates refills them one
+	// lane at a time; interleaved with draw_all(), each engine must still
+	// match a standalone engine, and engine(i) must continue its sequence
+
+	static constexpr std::size_t uneven_count = 37;
+
+	static_assert(std::is_nothrow_move_constructible<utils::isaac_bank<4>>::value, "banks move without copying");
+
+	std::vector<utils::isaac<4>::result_type> uneven_seeds(agent_seeds.begin(), agent_seeds.begin() + uneven_count);
+	utils::isaac_bank<4> uneven_bank{uneven_seeds};
+	std::vector<utils::isaac<4>> uneven_agents(uneven_seeds.begin(), uneven_seeds.end());
+	std::vector<utils::isaac<4>::result_type> uneven_draws(uneven_count);
+	for (std::size_t round = 0; round < 40; ++round)
+	{
+		for (std::size_t i = 0; i < uneven_count; ++i)
+		{
+			for (std::size_t k = 0; k < (i + round) % 5; ++k)
+			{
+				if (uneven_bank(i) != uneven_agents[i]())
+				{
+					std::cout << "isaac_bank mismatch for engine " << i << " in round " << round << std::endl;
+					return 1;
+				}
+			}
+		}
+		uneven_bank.draw_all(uneven_draws.data());
+		for (std::size_t i = 0; i < uneven_count; ++i)
+		{
+			if (uneven_draws[i] != uneven_agents[i]())
+			{
+				std::cout << "isaac_bank draw_all mismatch for engine " << i << " in round " << round << std::endl;
+				return 1;
+			}
+		}
+	}
+	for (std::size_t i = 0; i < uneven_count; ++i)
+	{
+		auto uneven_engine = uneven_bank.engine(i);
+		if (uneven_engine != uneven_agents[i] || !same_sequence(uneven_engine, uneven_agents[i], 100))
+		{
+			std::cout << "isaac_bank engine() mismatch for engine " << i << std::endl;
+			return 1;
+		}
+	}
+
+	// Lazy engines hold only a seed and a position until they are first used,
+	// so a large population that is mostly idle is cheap to create
+
+	static constexpr std::size_t population = 1000000;
+
+	auto lazy_start = std::chrono::system_clock::now();
+	std::vector<utils::lazy_isaac<utils::isaac<4>>> lazy_agents;
+	lazy_agents.reserve(population);
+	for (std::size_t i = 0; i < population; ++i)
+	{
+		lazy_agents.emplace_back(static_cast<std::uint32_t>(i));
+	}
+	for (std::size_t i = 0; i < population; i += 100)
+	{
+		value += lazy_agents[i]();
+	}
+	auto lazy_finish = std::chrono::system_clock::now();
+
+	std::cout << "creating " << population << " lazy isaac<4> engines and using 1% of them = "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(lazy_finish - lazy_start).count() << " ms" << std::endl;
+
+	// a demoted engine picks up where it left off
+
+	auto& lazy_agent = lazy_agents[population - 100];
+	lazy_agent.demote();
+	utils::isaac<4> eager_agent{static_cast<std::uint32_t>(population - 100)};
+	eager_agent.discard(1);
+	if (lazy_agent.is_materialized() || lazy_agent() != eager_agent())
+	{
+		std::cout << "lazy_isaac mismatch" << std::endl;
+		return 1;
+	}
+
+	// Forking a forkable_isaac shares the state until a fork needs a new block;
+	// a fork must draw the same values as a copy of the engine
+
+	static constexpr std::size_t fork_count = 1000000;
+
+	utils::forkable_isaac<utils::isaac64<alpha>> fork_root{igen};
+	utils::isaac64<alpha> copy_root{igen};
+
+	auto fork_start = std::chrono::system_clock::now();
+	for (std::size_t i = 0; i < fork_count; ++i)
+	{
+		auto branch = fork_root.fork();
+		value += branch() + branch();
+	}
+	auto fork_finish = std::chrono::system_clock::now();
+	for (std::size_t i = 0; i < fork_count; ++i)
+	{
+		auto branch = copy_root;
+		value += branch() + branch();
+	}
+	auto copy_finish = std::chrono::system_clock::now();
+
+	std::cout << "forking " << fork_count << " branches, forkable_isaac = "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(fork_finish - fork_start).count() << " ms, copying isaac64 = "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(copy_finish - fork_finish).count() << " ms" << std::endl;
+
+	auto fork_branch = fork_root.fork();
+	utils::isaac64<alpha> copy_branch{copy_root};
+	for (std::size_t i = 0; i < 1000; ++i)
+	{
+		if (fork_branch() != copy_branch())
+		{
+			std::cout << "forkable_isaac mismatch at " << i << std::endl;
+			return 1;
+		}
+	}
+
+	// isaac_entropy seeds an engine with one request to the operating system,
+	// optionally mixing in RDRAND; engines seeded this way must differ
+
+	static constexpr std::size_t seed_count = 1000;
+
+	utils::isaac_entropy entropy;
+	utils::isaac_entropy rdrand_entropy(utils::cpu_entropy::rdrand);
+	utils::isaac64<alpha> seeded_gen;
+
+	auto seed_start = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < seed_count; ++i)
+	{
+		seeded_gen.seed(rdev);
+		value += seeded_gen();
+	}
+	auto seed_entropy = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < seed_count; ++i)
+	{
+		seeded_gen.seed(entropy);
+		value += seeded_gen();
+	}
+	auto seed_rdrand = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i < seed_count; ++i)
+	{
+		seeded_gen.seed(rdrand_entropy);
+		value += seeded_gen();
+	}
+	auto seed_finish = std::chrono::steady_clock::now();
+
+	std::cout << "seeding isaac64 " << seed_count << " times, random_device = "
+		<< std::chrono::duration_cast<std::chrono::microseconds>(seed_entropy - seed_start).count() / seed_count << " us, isaac_entropy = "
+		<< std::chrono::duration_cast<std::chrono::microseconds>(seed_rdrand - seed_entropy).count() / seed_count << " us, with rdrand = "
+		<< std::chrono::duration_cast<std::chrono::microseconds>(seed_finish - seed_rdrand).count() / seed_count << " us" << std::endl;
+
+	utils::isaac<alpha> entropy_gen1{entropy};
+	utils::isaac<alpha> entropy_gen2{rdrand_entropy};
+	utils::isaac64<alpha> entropy_gen3{entropy};
+	utils::isaac64<alpha> entropy_gen4{rdrand_entropy};
+
+	std::cout << "isaac_entropy os_failed = " << entropy.os_failed() << ", with rdrand os_failed = " << rdrand_entropy.os_failed()
+		<< ", cpu_failed = " << rdrand_entropy.cpu_failed() << std::endl;
+
+	if (entropy_gen1 == entropy_gen2 || entropy_gen1 == utils::isaac<alpha>{} ||
+		entropy_gen3 == entropy_gen4 || entropy_gen3 == utils::isaac64<alpha>{} || entropy_gen4 == seeded_gen)
+	{
+		std::cout << "isaac_entropy seeded identical engines" << std::endl;
+		return 1;
+	}
+
+	// An isaac_pool gives each thread an engine of its own; a thread that gives
+	// its ordinal draws the sequence of make() for that ordinal
+
+	static constexpr std::size_t pool_threads = 4;
+	static constexpr std::size_t pool_draws = 10000;
+
+	utils::isaac_pool<utils::isaac64<alpha>> pool{igen()};
+	std::vector<std::vector<utils::isaac64<alpha>::result_type>> pool_values(pool_threads);
+	std::vector<std::thread> pool_workers;
+	for (std::size_t w = 0; w < pool_threads; ++w)
+	{
+		pool_workers.emplace_back([&pool, &pool_values, w]()
+		{
+			for (std::size_t i = 0; i < pool_draws; ++i)
+			{
+				pool_values[w].push_back(pool.local(w)());
+			}
+		});
+	}
+	for (auto& worker : pool_workers)
+	{
+		worker.join();
+	}
+	for (std::size_t w = 0; w < pool_threads; ++w)
+	{
+		auto pool_check = pool.make(w);
+		for (std::size_t i = 0; i < pool_draws; ++i)
+		{
+			if (pool_values[w][i] != pool_check())
+			{
+				std::cout << "isaac_pool mismatch for ordinal " << w << " at " << i << std::endl;
+				return 1;
+			}
+		}
+	}
+	if (pool.size() != pool_threads)
+	{
+		std::cout << "isaac_pool constructed " << pool.size() << " engines for " << pool_threads << " threads" << std::endl;
+		return 1;
+	}
+
+	// isaac_percpu shares one engine per CPU between threads; every value
+	// drawn must come from some CPU's engine, seeded as the pool's engine of
+	// that ordinal, with none lost or repeated
+
+	static constexpr std::size_t percpu_threads = 8;
+	static constexpr std::size_t percpu_draws = 100000;
+
+	utils::isaac_percpu<utils::isaac64<alpha>> percpu{pool.master_seed()};
+	std::vector<std::vector<utils::isaac64<alpha>::result_type>> percpu_values(percpu_threads);
+	std::vector<std::thread> percpu_workers;
+	auto percpu_start = std::chrono::system_clock::now();
+	for (std::size_t w = 0; w < percpu_threads; ++w)
+	{
+		percpu_workers.emplace_back([&percpu, &percpu_values, w]()
+		{
+			percpu_values[w].reserve(percpu_draws);
+			for (std::size_t i = 0; i < percpu_draws; ++i)
+			{
+				percpu_values[w].push_back(percpu());
+			}
+		});
+	}
+	for (auto& worker : percpu_workers)
+	{
+		worker.join();
+	}
+	auto percpu_finish = std::chrono::system_clock::now();
+
+	std::cout << "drawing " << percpu_draws << " values on each of " << percpu_threads << " threads, isaac_percpu (rseq = "
+		<< utils::isaac_percpu<utils::isaac64<alpha>>::uses_rseq() << ") = "
+		<< std::chrono::duration_cast<std::chrono::milliseconds>(percpu_finish - percpu_start).count() << " ms" << std::endl;
+
+	// each CPU's engine (and the overflow engine, numbered size()) was drawn
+	// from in sequence, so walking its sequence must match drawn values until
+	// the first one that wasn't drawn
+
+	std::vector<utils::isaac64<alpha>::result_type> percpu_drawn;
+	for (auto& values : percpu_values)
+	{
+		percpu_drawn.insert(percpu_drawn.end(), values.begin(), values.end());
+	}
+	std::sort(percpu_drawn.begin(), percpu_drawn.end());
+	std::vector<bool> percpu_matched(percpu_drawn.size());
+	std::size_t percpu_match_count = 0;
+	for (std::size_t cpu = 0; cpu <= percpu.size(); ++cpu)
+	{
+		auto percpu_check = pool.make(cpu);
+		for (;;)
+		{
+			auto expected = percpu_check();
+			auto found = std::lower_bound(percpu_drawn.begin(), percpu_drawn.end(), expected);
+			std::size_t index = found - percpu_drawn.begin();
+			if (found == percpu_drawn.end() || *found != expected || percpu_matched[index])
+			{
+				break;
+			}
+			percpu_matched[index] = true;
+			++percpu_match_count;
+		}
+	}
+	if (percpu_match_count != percpu_drawn.size())
+	{
+		std::cout << "isaac_percpu drew " << percpu_drawn.size() - percpu_match_count << " values out of sequence" << std::endl;
+		return 1;
+	}
+
+	// Generates a block from each of many engines in turn, with their state on
+	// each NUMA node in turn; there are enough engines that the state isn't in
+	// the caches, so each block's lookups into memory_ go to the node's memory
+
+	static constexpr std::size_t numa_engine_count = 16384;
+	static constexpr std::size_t numa_rounds = 8;
+
+	int home_node = utils::isaac_numa_node();
+	for (int node = 0; node < utils::isaac_numa_node_count(); ++node)
+	{
+		std::vector<utils::numa_isaac64<alpha>> numa_bank;
+		numa_bank.reserve(numa_engine_count);
+		for (std::size_t i = 0; i < numa_engine_count; ++i)
+		{
+			numa_bank.push_back(utils::make_isaac_on_node<utils::numa_isaac64<alpha>>(node, i));
+		}
+		auto numa_start = std::chrono::system_clock::now();
+		for (std::size_t round = 0; round < numa_rounds; ++round)
+		{
+			for (auto& gen : numa_bank)
+			{
+				gen.discard(std::size_t(1) << alpha);
+				value += gen.peek().size;
+			}
+		}
+		auto numa_finish = std::chrono::system_clock::now();
+		std::cout << "generating " << numa_rounds << " blocks from each of " << numa_engine_count << " engines on node " << node
+			<< (node == home_node ? " (local) = " : " (remote) = ")
+			<< std::chrono::duration_cast<std::chrono::milliseconds>(numa_finish - numa_start).count() << " ms" << std::endl;
+	}
+
+	utils::numa_isaac64<alpha> numa_gen = utils::make_local_isaac<utils::numa_isaac64<alpha>>(5u);
+	utils::isaac64<alpha> numa_check{5u};
+	for (std::size_t i = 0; i < 1000; ++i)
+	{
+		if (numa_gen() != numa_check())
+		{
+			std::cout << "numa_isaac64 mismatch at " << i << std::endl;
+			return 1;
+		}
+	}
+
+	// isaac_async generates blocks on a refill thread, and isaac_incremental a
+	// step per call, so that the call that starts a block doesn't generate it;
+	// their sequences must be that of the engine
+
+	static constexpr std::size_t call_count = 1 << 22;
+
+	utils::isaac64<alpha> sync_gen{igen};
+	utils::isaac_async<utils::isaac64<alpha>> async_gen{igen};
+	utils::isaac_incremental<utils::isaac64<alpha>> incremental_gen{igen};
+
+	auto sync_calls = time_calls(sync_gen, call_count, value);
+	auto async_calls = time_calls(async_gen, call_count, value);
+	auto incremental_calls = time_calls(incremental_gen, call_count, value);
+
+	std::cout << call_time_unit << " per call (median, 99.9th percentile, slowest) of " << call_count << " calls, isaac64 = "
+		<< sync_calls[0] << ", " << sync_calls[1] << ", " << sync_calls[2] << "; isaac_async = "
+		<< async_calls[0] << ", " << async_calls[1] << ", " << async_calls[2] << "; isaac_incremental = "
+		<< incremental_calls[0] << ", " << incremental_calls[1] << ", " << incremental_calls[2] << std::endl;
+
+	utils::isaac64<alpha> async_check{igen};
+	async_check.discard(call_count);
+	for (std::size_t i = 0; i < 1000; ++i)
+	{
+		auto expected = async_check();
+		if (async_gen() != expected)
+		{
+			std::cout << "isaac_async mismatch at " << i << std::endl;
+			return 1;
+		}
+		if (incremental_gen() != expected)
+		{
+			std::cout << "isaac_incremental mismatch at " << i << std::endl;
+			return 1;
+		}
+	}
 
 	// Added as example for LeMoussel (see issue https://github.com/edgeofmagic/ISAAC-engine/issues/1):
 
-	auto start = std::chrono::system_clock::now();
+	utils::isaac64<alpha> word_gen{igen};	// copy of the state, used to check the nonces below
+
+	static constexpr std::size_t nonce_count = 1000000;
+	static constexpr std::size_t check_count = 1000;
 
 	unsigned char nonce96[12];
+	unsigned char expected[sizeof(nonce96) * check_count];
 
-	for (uint32_t j = 0; j < 1000000; j++) {
-		random_fill(igen, nonce96, sizeof(nonce96));
+	auto start = std::chrono::system_clock::now();
+
+	for (uint32_t j = 0; j < nonce_count; j++) {
+		igen.fill_bytes(nonce96, sizeof(nonce96));
 	}
 
 	auto finish = std::chrono::system_clock::now();
 	auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(finish - start);
 
-	std::cout << "elapsed time for random_fill(1000000 iterations): " << elapsed_ms.count() << " milliseconds." << std::endl;
+	std::cout << "elapsed time for fill_bytes(" << nonce_count << " iterations): " << elapsed_ms.count() << " milliseconds." << std::endl;
+
+	// fill_bytes() doesn't discard the unused part of a word, so the nonces
+	// must be exactly the byte stream of consecutive words from the engine
+
+	utils::isaac64<alpha> byte_gen{word_gen};
+	utils::isaac64<alpha>::result_type words[sizeof(expected) / sizeof(utils::isaac64<alpha>::result_type)];
+	word_gen.generate(words, sizeof(words) / sizeof(words[0]));
+	::memcpy(expected, words, sizeof(expected));
+
+	for (std::size_t j = 0; j < check_count; j++) {
+		byte_gen.fill_bytes(nonce96, sizeof(nonce96));
+		if (::memcmp(nonce96, expected + j * sizeof(nonce96), sizeof(nonce96)) != 0)
+		{
+			std::cout << "fill_bytes mismatch at nonce " << j << std::endl;
+			return 1;
+		}
+	}
+
 	return 0;
 }
 